@@ -8,7 +8,81 @@
 #define EXTRA_CHANNELS_COUNT   12
 #define ONOFF_CHANNELS_COUNT   48
 
-#define MAX_DELTA              0
+// Uncomment to trade a few CPU cycles for RAM on small parts (ATtiny class):
+// channel widths are stored packed on 12 bits (two channels every three
+// bytes) and unpacked by the accessors on read.
+//
+// #define TPPM_COMPACT_STORAGE
+
+// Uncomment to smooth the multiplexed extra channels between their scan
+// refreshes (every 4 frames) with a linear predictor:
+//
+// - PREDICT_INTERPOLATE: from the previous to the last refreshed value,
+//                        delayed by one refresh period
+// - PREDICT_EXTRAPOLATE: beyond the last refreshed value, no delay but
+//                        overshooting on the stick reversals
+//
+#define PREDICT_INTERPOLATE    1
+#define PREDICT_EXTRAPOLATE    2
+
+// #define TPPM_EXTRA_PREDICTOR   PREDICT_EXTRAPOLATE
+
+// Uncomment to protect the superimposed tag with an extended Hamming code
+// instead of the three parity bits (see TPPMTagCode.h): a pulse read one
+// level off is corrected, two are detected. The encoder id is 5 bits wide
+// and the transmitter must use the same coding.
+//
+// #define TPPM_TAG_FEC
+
+// Uncomment to decode the 8 levels symbols of the superimposed tag, 20 us
+// apart: the third bit of each pulse refreshes a second scan slot of on/off
+// channels (see TPPMTag.h). The decoder falls back to the 4 levels on its own
+// when the pulses are too close to the middle of their level.
+//
+// #define TPPM_TAG_8_LEVELS
+
+// Uncomment to decode the sync gap symbols: the transmitter moves the sync gap
+// by up to +/-1 ms to quantise it, the residue refreshes a further scan slot
+// of on/off channels (see TPPMTag.h). The transmitter must use the same
+// coding, and the transmitter and receiver clocks must agree within 0.03% (a
+// crystal, not a ceramic resonator, or see TPPM_CLOCK_REFERENCE_US).
+//
+// #define TPPM_SYNC_SYMBOLS
+
+// Uncomment to compensate a receiver clock off by up to 3% (a ceramic
+// resonator): the transmitter's frame period, in microseconds of its crystal
+// clock, is the reference the decoder estimates the clocks ratio from, over
+// the long run, and all the widths are rescaled by it (see TPPMClock.h). The
+// transmitter must keep a fixed frame period, on average with
+// TPPM_SYNC_SYMBOLS.
+//
+// #define TPPM_CLOCK_REFERENCE_US 22500
+
+// Uncomment to address up to 3840 receivers: the decoder id is 12 bits wide,
+// its 8 high bits (the page) are sent by the transmitter in page select
+// frames, a nibble per frame, ahead of the frames addressed to the page (see
+// TPPMTag.h). The decoder ids 15, 31, 47, ... are reserved and the
+// transmitter must use the same addressing.
+//
+// #define TPPM_EXTENDED_ADDRESS
+
+// Uncomment to drive D13 (PB5, the on-board LED) high while the decoder's
+// interrupts run: the pulses seen on a scope or a logic analyser are their
+// run times, the longest one is the worst case the other interrupts of the
+// sketch wait for (see the ISR RUN TIME section of the README).
+//
+// #define TPPM_ISR_PROBE
+
+// Number of tagged transmitters known to the decoder, the one it locked on
+// included (see TPPMSum::add_transmitter()): a known transmitter takes over
+// the outputs on its next frame when the one driving them is lost. With 1 the
+// decoder follows the transmitter it locked on only, and no table is built.
+// Not with TPPM_EXTENDED_ADDRESS, the page selects bind the decoder to the
+// transmitter sending them.
+//
+#if !defined(TRANSMITTERS)
+#define TRANSMITTERS           1
+#endif
 
 #define GUARD_US               25
 
@@ -19,13 +93,35 @@
 
 #define MIN_PULSE_WIDTH_US     300
 
-#define USEC_TO_WIDTH(us)      (us) // TODO
+// Timer1 clock prescaler, one of 1, 8, 64 or 256.
+//
+// At 8 the timer resolution is 1 us @ 8 MHz, 0.5 us @ 16 MHz and 0.4 us @ 20 MHz.
+//
+#if !defined(TIMER1_PRESCALER)
+#define TIMER1_PRESCALER       8
+#endif
+
+#if !defined(F_CPU)
+#error "F_CPU must be defined to derive the Timer1 ticks"
+#endif
+
+// Timer1 ticks <-> time conversions, all evaluated at compile time
+//
+#define TICKS_PER_MS           ( F_CPU / ( TIMER1_PRESCALER * 1000UL ) )
+
+#define USEC_TO_WIDTH(us)      ( ( (us) * ( F_CPU / 1000UL ) ) / ( TIMER1_PRESCALER * 1000UL ) )
+#define WIDTH_TO_USEC(w)       ( ( (uint32_t)(w) * ( TIMER1_PRESCALER * 1000UL ) ) / ( F_CPU / 1000UL ) )
+#define MSEC_TO_WIDTH(ms)      ( (ms) * TICKS_PER_MS )
 
 #define SEC_TO_MS(s)           ((s)*1000)
 #define MS_TO_USEC(ms)         ((ms)*1000)
 
+// Signal widths are 16 bits wide, longer signals are saturated to this value
+//
+#define MAX_SIGNAL_WIDTH       0xffff
+
 #define ONOFF_CHANNELS_BYTES   (ONOFF_CHANNELS_COUNT >> 3)
-#define MIM_CHANNELS           BASIC_CHANNELS_COUNT
+#define MIN_CHANNELS           BASIC_CHANNELS_COUNT
 #define MAX_CHANNELS           ( BASIC_CHANNELS_COUNT + EXTRA_CHANNELS_COUNT )
 
 #define MAX_PULSE_WIDTH_US     ( MIN_CHANNEL_WIDTH_US - MIN_PULSE_WIDTH_US - 2 * GUARD_US )
@@ -43,21 +139,97 @@
 #define MAX_CHANNEL_WIDTH      USEC_TO_WIDTH( MAX_CHANNEL_WIDTH_US + GUARD_US)
 
 #define MIN_SYNC_WIDTH         USEC_TO_WIDTH( MIN_SYNC_WIDTH_US )
-#define MAX_SYNC_WIDTH         USEC_TO_WIDTH( MAX_SYNC_WIDTH_US )
 
-#if MAX_DELTA==0
-#define ARE_VERY_CLOSE(a,b) ((a)==(b))
+#if USEC_TO_WIDTH( MAX_SYNC_WIDTH_US ) < MAX_SIGNAL_WIDTH
+#define MAX_SYNC_WIDTH         USEC_TO_WIDTH( MAX_SYNC_WIDTH_US )
 #else
-#define ARE_VERY_CLOSE(a,b) ((((a)>(b)) ? (a)-(b) : (b)-(a)) <= MAX_DELTA)
+#define MAX_SYNC_WIDTH         ( MAX_SIGNAL_WIDTH - 1 ) // a saturated width is never a sync
+#endif
+
+#if defined(TPPM_COMPACT_STORAGE) && ( MAX_CHANNEL_WIDTH > 0x0fff )
+#error "TPPM_COMPACT_STORAGE: the channel widths do not fit in 12 bits, raise TIMER1_PRESCALER"
+#endif
+
+#if ( MAX_CHANNEL_WIDTH * ( MAX_CHANNELS + 1 ) ) > 0xffff
+#define WIDE_WIDTH_SUM
 #endif
 
 #define IS_IN_RANGE(cval,vmin,vmax) (((cval)>=(vmin)) && ((cval)<=(vmax)))
 
 namespace TPPM
 {
-    typedef uint16_t[BASIC_CHANNELS_COUNT] BasicChannels;
-    typedef uint16_t[EXTRA_CHANNELS_COUNT] ExtraChannels;
-    typedef uint8_t [ONOFF_CHANNELS_BYTES] OnOffChannels;
+    typedef uint16_t BasicChannels[BASIC_CHANNELS_COUNT];
+    typedef uint16_t ExtraChannels[EXTRA_CHANNELS_COUNT];
+    typedef uint8_t  OnOffChannels[ONOFF_CHANNELS_BYTES];
+
+#if defined(WIDE_WIDTH_SUM)
+    typedef uint32_t WidthSum; // sum of the widths of a whole frame
+#else
+    typedef uint16_t WidthSum; // sum of the widths of a whole frame
+#endif
+
+#if defined(TPPM_COMPACT_STORAGE)
+    // Two 12 bits channels every three bytes:
+    //
+    // +--------+-------------+-------------+-------------+
+    // |  byte  |      0      |      1      |      2      |
+    // +--------+-------------+------+------+-------------+
+    // |  bits  |    7..0     | 3..0 | 7..4 |    7..0     |
+    // +--------+-------------+------+------+-------------+
+    // | 2n     |  bits 7..0  | 11..8|      |             |
+    // | 2n+1   |             |      | 3..0 | bits 11..4  |
+    // +--------+-------------+------+------+-------------+
+    //
+    #define CHANNEL_WORDS(channels) ( ( ( (channels) * 3 ) + 1 ) >> 1 )
+
+    typedef uint8_t ChannelWord;
+
+    typedef uint8_t FrameStamp;  // frames counter, wraps around every 256 frames
+
+    inline uint16_t get_channel(const ChannelWord *channels, const uint8_t &index)
+    {
+        const ChannelWord *word = channels + ((index * 3) >> 1);
+
+        if (index & 1)
+        {
+            return (word[0] >> 4) | ((uint16_t)word[1] << 4);
+        }
+
+        return word[0] | ((uint16_t)(word[1] & 0x0f) << 8);
+    }
+
+    inline void set_channel(ChannelWord *channels, const uint8_t &index, const uint16_t &width)
+    {
+        ChannelWord *word = channels + ((index * 3) >> 1);
+
+        if (index & 1)
+        {
+            word[0] = (word[0] & 0x0f) | ((width << 4) & 0xf0);
+            word[1] = (width >> 4);
+        }
+        else
+        {
+            word[0] = width;
+            word[1] = (word[1] & 0xf0) | ((width >> 8) & 0x0f);
+        }
+    }
+#else
+    #define CHANNEL_WORDS(channels) (channels)
+
+    typedef uint16_t ChannelWord;
+
+    typedef uint16_t FrameStamp; // frames counter, wraps around every 65536 frames
+
+    inline uint16_t get_channel(const ChannelWord *channels, const uint8_t &index)
+    {
+        return channels[index];
+    }
+
+    inline void set_channel(ChannelWord *channels, const uint8_t &index, const uint16_t &width)
+    {
+        channels[index] = width;
+    }
+#endif
 };
 
 #endif // __TPPM_CFG_H__
@@ -0,0 +1,171 @@
+#if !defined(__TPPM_CLOCK_H__)
+#define __TPPM_CLOCK_H__
+
+#include "TPPMCfg.h"
+
+// The clock ratio is kept in fixed point, CLOCK_RATIO_ONE being 1.0
+//
+#define CLOCK_RATIO_BITS          15
+#define CLOCK_RATIO_ONE           ( (uint32_t)1 << CLOCK_RATIO_BITS )
+
+// Farthest ratio from 1.0 compensated: 3%, a ceramic resonator is within 1%
+//
+#define CLOCK_MAX_DRIFT           ( ( CLOCK_RATIO_ONE * 3 ) / 100 )
+
+// The frame periods are summed over blocks of CLOCK_BLOCK_FRAMES good frames:
+// the sync gap symbols move each period by up to 2 ms, their sum by no more
+// than their rounding and the longer syncs on the short frames, 3 ms: 0.1% of
+// a 128 frames block, then averaged well within the 0.03% the sync gap
+// symbols tolerate
+//
+#define CLOCK_BLOCK_SHIFT         7
+#define CLOCK_BLOCK_FRAMES        ( 1 << CLOCK_BLOCK_SHIFT )
+#define CLOCK_BLOCK_JITTER        USEC_TO_WIDTH( 3000 )
+
+// Exponential moving average weight of a new block mean period: 1/8, the long
+// run period only. The first block is taken as it is if farther from the
+// reference than the sync gap symbols can move it: the clocks differ.
+//
+#define CLOCK_AVERAGE_SHIFT       3
+
+// The averaged period is kept in fixed point with CLOCK_PERIOD_FRACTION_BITS
+// fractional bits
+//
+#define CLOCK_PERIOD_FRACTION_BITS 8
+
+#if defined(TPPM_CLOCK_REFERENCE_US)
+
+#define CLOCK_REFERENCE           USEC_TO_WIDTH( TPPM_CLOCK_REFERENCE_US )
+
+// Only the blocks within 4% of the reference are accounted: a sync missed
+// doubles a period, a transmitter with another frame period is no reference
+//
+#define CLOCK_BLOCK_REFERENCE     ( (uint32_t)CLOCK_REFERENCE << CLOCK_BLOCK_SHIFT )
+#define CLOCK_BLOCK_WINDOW        ( CLOCK_BLOCK_REFERENCE / 25 )
+
+#if CLOCK_REFERENCE >= MAX_SIGNAL_WIDTH
+#error "TPPM_CLOCK_REFERENCE_US: the reference period does not fit in 16 bits, raise TIMER1_PRESCALER"
+#endif
+
+#endif
+
+// The ratio of the transmitter clock to the receiver one, estimated from the
+// long run frame period of a transmitter with a known, fixed frame period (see
+// TPPM_CLOCK_REFERENCE_US).
+//
+// scale() rescales the widths measured by the receiver clock to the
+// transmitter's: all the width limits, the tag symbol levels and the sync gap
+// symbols are then met as if the clocks were the same. A multiply per edge,
+// the ratio is computed once per block of frames.
+//
+class TPPMClock
+{
+public:
+    TPPMClock()
+    {
+        reset();
+    }
+
+    // Assume the clocks are the same
+    //
+    inline void reset()
+    {
+#if defined(TPPM_CLOCK_REFERENCE_US)
+        _period = (uint32_t)CLOCK_REFERENCE << CLOCK_PERIOD_FRACTION_BITS;
+#else
+        _period = 0;
+#endif
+        _ratio  = CLOCK_RATIO_ONE;
+        _sum    = 0;
+        _frames = 0;
+        _blocks = 0;
+    }
+
+    // Account the period of a good frame, in receiver ticks
+    //
+    inline void frame(const uint16_t &period)
+    {
+#if defined(TPPM_CLOCK_REFERENCE_US)
+        _sum += period;
+
+        if (++_frames < CLOCK_BLOCK_FRAMES)
+        {
+            return;
+        }
+
+        uint32_t sum = _sum;
+
+        _sum    = 0;
+        _frames = 0;
+
+        if (!IS_IN_RANGE(sum, CLOCK_BLOCK_REFERENCE - CLOCK_BLOCK_WINDOW, CLOCK_BLOCK_REFERENCE + CLOCK_BLOCK_WINDOW))
+        {
+            return;
+        }
+
+        sum <<= (CLOCK_PERIOD_FRACTION_BITS - CLOCK_BLOCK_SHIFT);
+
+        int32_t error  = (int32_t)sum - (int32_t)_period;
+        int32_t jitter = (int32_t)CLOCK_BLOCK_JITTER << (CLOCK_PERIOD_FRACTION_BITS - CLOCK_BLOCK_SHIFT);
+
+        if ((0 == _blocks) && !IS_IN_RANGE(error, -jitter, jitter))
+        {
+            _period = sum;
+        }
+        else
+        {
+            _period += error >> CLOCK_AVERAGE_SHIFT;
+        }
+
+        _blocks = 1;
+
+        uint32_t ratio = ((uint32_t)CLOCK_REFERENCE << CLOCK_RATIO_BITS)
+                         /
+                         ((_period + (1 << (CLOCK_PERIOD_FRACTION_BITS - 1))) >> CLOCK_PERIOD_FRACTION_BITS);
+
+        if (ratio < (CLOCK_RATIO_ONE - CLOCK_MAX_DRIFT))
+        {
+            ratio = CLOCK_RATIO_ONE - CLOCK_MAX_DRIFT;
+        }
+        else
+        if (ratio > (CLOCK_RATIO_ONE + CLOCK_MAX_DRIFT))
+        {
+            ratio = CLOCK_RATIO_ONE + CLOCK_MAX_DRIFT;
+        }
+
+        _ratio = ratio;
+#else
+        (void)period;
+#endif
+    }
+
+    // Returns the width in transmitter ticks, rounded, a saturated width stays so
+    //
+    inline uint16_t scale(const uint16_t &width)
+    {
+        if (MAX_SIGNAL_WIDTH == width)
+        {
+            return width;
+        }
+
+        uint32_t scaled = (((uint32_t)width * _ratio) + (CLOCK_RATIO_ONE >> 1)) >> CLOCK_RATIO_BITS;
+
+        return (scaled < MAX_SIGNAL_WIDTH) ? scaled : (MAX_SIGNAL_WIDTH - 1);
+    }
+
+    // Returns the transmitter ticks per receiver tick, CLOCK_RATIO_ONE is 1.0
+    //
+    inline uint16_t ratio()
+    {
+        return _ratio;
+    }
+
+private:
+    uint32_t _period; // averaged, receiver ticks, CLOCK_PERIOD_FRACTION_BITS
+    uint16_t _ratio ;
+    uint32_t _sum   ; // of the periods of the block
+    uint8_t  _frames; // in the block
+    uint8_t  _blocks; // 0: no block accounted yet
+};
+
+#endif // __TPPM_CLOCK_H__
@@ -0,0 +1,208 @@
+#if !defined(__TPPM_DIVERSITY_H__)
+#define __TPPM_DIVERSITY_H__
+
+#include "TPPMSum.h"
+
+// DIVERSITY_RAM_BUDGET: the RAM the two decoders may take, by default half of
+// the AVR's, the other half left to the sketch and the stack. Two decoders
+// with the default options do not fit the 2 KB of the ATmega328 owning the
+// D8 and D9 pins: define TPPM_COMPACT_STORAGE, or lower MODULE_TABLES.
+//
+#if !defined(DIVERSITY_RAM_BUDGET) && defined(RAMEND) && defined(RAMSTART)
+#define DIVERSITY_RAM_BUDGET   ( ( RAMEND - RAMSTART + 1 ) / 2 )
+#endif
+
+#if defined(DIVERSITY_RAM_BUDGET)
+static_assert(2 * sizeof(TPPMSum) <= DIVERSITY_RAM_BUDGET, "Two decoders do not fit DIVERSITY_RAM_BUDGET: define TPPM_COMPACT_STORAGE or lower MODULE_TABLES");
+#endif
+
+namespace TPPM
+{
+    // The links with a good frame since the last TPPMDiversity::read()
+    //
+    enum Links
+    {
+        NO_LINK        = 0,
+        PRIMARY_LINK   = 1,
+        SECONDARY_LINK = 2,
+        BOTH_LINKS     = 3
+    };
+};
+
+// Frame level diversity of two receivers: two decoders, one on each input
+// (see TPPM::Input), decode the same transmitter in parallel and read()
+// combines them, per frame:
+//
+// - one link with a good frame: its channels are used
+// - both links with a good frame: the sub-module and the extra and on/off
+//   channels come from the link with the better quality score, each basic
+//   channel is the one of the two closer to its previous value (a glitch on
+//   one link is rejected, jitter is not added)
+// - no link with a good frame: the link used last holds its last good frame,
+//   then its fail safe one, as a single decoder does
+//
+// A frame is then lost only if it is lost by both links. As the flight
+// recorder, nothing is done in the ISR: read() polls the decoders from the
+// sketch's loop(), at least once per frame.
+//
+class TPPMDiversity
+{
+public:
+    TPPMDiversity(TPPMSum &primary, TPPMSum &secondary)
+        : _links      (TPPM::NO_LINK)
+        , _source     (0)
+        , _lost_frames(0)
+    {
+        _decoders[0] = &primary;
+        _decoders[1] = &secondary;
+
+        _stamps[0] = 0;
+        _stamps[1] = 0;
+
+        for (uint8_t c=0; c<BASIC_CHANNELS_COUNT; ++c)
+        {
+            _basic[c] = 0;
+        }
+    }
+
+    // Retrieve the combined channels data and returns the current controlled
+    // sub-module (see TPPMSum::read())
+    //
+    inline uint8_t read(TPPM::BasicChannels basic_channels,
+                        TPPM::ExtraChannels extra_channels,
+                        TPPM::OnOffChannels onoff_channels)
+    {
+        bool    fresh = false;
+        uint8_t links = TPPM::NO_LINK;
+
+        for (uint8_t d=0; d<2; ++d)
+        {
+            if (good_frames(d, fresh))
+            {
+                links |= (1 << d);
+            }
+        }
+
+        if (TPPM::BOTH_LINKS == links)
+        {
+            TPPM::LinkQuality quality[2];
+
+            _decoders[0]->link_quality(quality[0]);
+            _decoders[1]->link_quality(quality[1]);
+
+            _source = (quality[1].score > quality[0].score) ? 1 : 0;
+        }
+        else
+        if (TPPM::NO_LINK != links)
+        {
+            _source = links >> 1;
+        }
+        else
+        if (fresh && (_lost_frames < 0xffff))
+        {
+            ++_lost_frames;
+        }
+
+        TPPM::BasicChannels basic;
+
+        uint8_t module = _decoders[_source]->read(basic, extra_channels, onoff_channels);
+
+        if (TPPM::BOTH_LINKS == links)
+        {
+            TPPM::BasicChannels other;
+
+            _decoders[!_source]->read(other, NULL, NULL);
+
+            for (uint8_t c=0; c<BASIC_CHANNELS_COUNT; ++c)
+            {
+                basic[c] = closer(_basic[c], basic[c], other[c]);
+            }
+        }
+
+        for (uint8_t c=0; c<BASIC_CHANNELS_COUNT; ++c)
+        {
+            _basic[c] = basic[c];
+
+            if (NULL != basic_channels)
+            {
+                basic_channels[c] = basic[c];
+            }
+        }
+
+        _links = links;
+
+        return module;
+    }
+
+    // Returns the links with a good frame at the last read()
+    //
+    inline TPPM::Links links()
+    {
+        return (TPPM::Links)_links;
+    }
+
+    // Returns true if the primary decoder was used by the last read()
+    //
+    inline bool primary_source()
+    {
+        return (0 == _source);
+    }
+
+    // Returns the reads with new frames, but none of them good on any link, up
+    // to 65535
+    //
+    inline uint16_t lost_frames()
+    {
+        return _lost_frames;
+    }
+
+private:
+    TPPMSum            *_decoders[2];
+    TPPM::FrameStamp    _stamps  [2]; // at the last read()
+    TPPM::BasicChannels _basic      ; // output at the last read()
+    uint8_t             _links      ;
+    uint8_t             _source     ; // the decoder used, 0: primary
+    uint16_t            _lost_frames;
+
+    // Returns true if the decoder has a good frame since the last read(),
+    // fresh is set if it has any new frame
+    //
+    inline bool good_frames(const uint8_t &decoder, bool &fresh)
+    {
+        TPPM::FrameStamp stamp;
+        uint32_t         history;
+
+        _decoders[decoder]->frame_status(stamp, history);
+
+        TPPM::FrameStamp frames = stamp - _stamps[decoder];
+
+        _stamps[decoder] = stamp;
+
+        if (0 == frames)
+        {
+            return false;
+        }
+
+        fresh = true;
+
+        uint32_t mask = (frames < 32) ? (((uint32_t)1 << frames) - 1) : 0xffffffffUL;
+
+        return (0 != (history & mask))
+               &&
+               !_decoders[decoder]->initializing()
+               &&
+               !_decoders[decoder]->fail_safe();
+    }
+
+    // Returns the one of the two widths closer to the previous one
+    //
+    static inline uint16_t closer(const uint16_t &previous, const uint16_t &a, const uint16_t &b)
+    {
+        uint16_t error_a = (a > previous) ? (a - previous) : (previous - a);
+        uint16_t error_b = (b > previous) ? (b - previous) : (previous - b);
+
+        return (error_b < error_a) ? b : a;
+    }
+};
+
+#endif // __TPPM_DIVERSITY_H__
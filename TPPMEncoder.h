@@ -0,0 +1,585 @@
+#if !defined(__TPPM_ENCODER_H__)
+#define __TPPM_ENCODER_H__
+
+#include "TPPMTag.h"
+
+// Tagged frames layout, as for doc/Codes10ch.txt
+//
+#define ENCODER_CHANNELS          LAYOUT_10CH_CHANNELS
+#define ENCODER_PULSES            ( ENCODER_CHANNELS + 1 )
+#define ENCODER_FRAME_PERIOD      USEC_TO_WIDTH( 22500 )
+
+// Tagged frames layout, as for doc/Codes8ch.txt: the frame is stretched
+// beyond its period if needed to keep the 4 ms sync gap
+//
+#define ENCODER_8CH_CHANNELS      LAYOUT_8CH_CHANNELS
+#define ENCODER_8CH_PULSES        ( ENCODER_8CH_CHANNELS + 1 )
+#define ENCODER_8CH_FRAME_PERIOD  USEC_TO_WIDTH( 20000 )
+#define ENCODER_8CH_MIN_SYNC      USEC_TO_WIDTH( 4000 )
+
+// Priority scan scheduling (see TPPMEncoder::set_priority_scan()): the scan
+// slots not refreshed for SCAN_MAX_AGE frames go first, then the slots whose
+// on/off channels changed, then the oldest ones
+//
+#define SCAN_MAX_AGE              ( ONOFF_SCAN_SLOTS * 2 )
+
+// Width of a symbol pulse and of an on/off channel, at the middle of their levels
+//
+#define SYMBOL_WIDTH(symbol)      ( NOMINAL_LEVEL(symbol) >> LEVEL_FRACTION_BITS )
+#define ONOFF_WIDTH(value)        ( MIN_CHANNEL_WIDTH + ( ONOFF_THRESHOLD_STEP * (value) ) + ( ONOFF_THRESHOLD_STEP / 2 ) )
+#define NIBBLE_WIDTH(value)       ( MIN_CHANNEL_WIDTH + ( ONOFF_NIBBLE_STEP * (value) ) + ( ONOFF_NIBBLE_STEP / 2 ) )
+
+// Width of an 8 levels symbol pulse: a symbol width moved to the middle of
+// the lower (half 0) or of the upper (half 1) half of its level
+//
+#define HALF_SYMBOL_WIDTH(width,half) ( (width) - ( CODE_THRESHOLD_STEP / 4 ) + ( (half) * ( CODE_THRESHOLD_STEP / 2 ) ) )
+
+// The transmitter side of the superimposed tag: builds the frames a TPPMSum
+// decoder expects, plain PPM or tagged.
+//
+// All the widths are in Timer1 ticks (see USEC_TO_WIDTH).
+//
+class TPPMEncoder
+{
+public:
+    // A frame: each channel is a pulse followed by a gap, the last channel
+    // is followed by one more pulse and by the sync gap
+    //
+    struct Frame
+    {
+        uint8_t  channels                    ;
+        uint16_t channel_width[MAX_CHANNELS] ; // pulse included
+        uint16_t pulse_width[MAX_CHANNELS + 1];
+        uint16_t sync_width                  ;
+    };
+
+    TPPMEncoder(const uint8_t         &encoder_id = 1                   ,
+                const TPPMTag::Layout &layout     = TPPMTag::LAYOUT_10CH)
+        : _encoder_id(encoder_id)
+        , _scan_index(0)
+        , _layout    (layout)
+        , _priority  (false)
+#if defined(TPPM_EXTENDED_ADDRESS)
+        , _page       (0)
+        , _page_step  (EXTENDED_PAGE_FRAMES)
+        , _page_frames(EXTENDED_PAGE_PERIOD) // select the first page right away
+#endif
+#if defined(TPPM_TAG_8_LEVELS)
+        , _high_order(false)
+#endif
+#if defined(TPPM_SYNC_SYMBOLS)
+        , _sync_debt (0)
+#endif
+    {
+        for (uint8_t s=0; s<REFRESH_SLOTS; ++s)
+        {
+            _age[s] = SCAN_MAX_AGE;
+        }
+
+        for (uint8_t s=0; s<ONOFF_SCAN_SLOTS; ++s)
+        {
+            _sent[s] = 0;
+        }
+    }
+
+    inline void set_encoder_id(const uint8_t &encoder_id)
+    {
+        _encoder_id = encoder_id;
+    }
+
+    // Select the tagged frames layout: TPPMTag::LAYOUT_10CH or
+    // TPPMTag::LAYOUT_8CH
+    //
+    inline void set_layout(const TPPMTag::Layout &layout)
+    {
+        _layout = layout;
+    }
+
+#if defined(TPPM_TAG_8_LEVELS)
+    // Superimpose 8 levels symbols (true) or 4 levels ones (false): on a
+    // clean link the 8 levels halve the frames refreshing all the on/off
+    // channels, the decoder falls back to 4 levels on its own when the link
+    // margin is too thin for them
+    //
+    inline void set_high_order(const bool &high_order)
+    {
+        _high_order = high_order;
+    }
+#endif
+
+    // Select the scan index of each frame by priority (true) or round robin
+    // (false): with priority a toggled switch is sent by the next frame,
+    // while no scan slot waits more than SCAN_MAX_AGE frames
+    //
+    inline void set_priority_scan(const bool &priority)
+    {
+        _priority = priority;
+    }
+
+    inline uint8_t scan_index()
+    {
+        return _scan_index;
+    }
+
+    // Returns the tag bits for the given fields, parity bits included
+    //
+    static inline uint32_t tag(const uint8_t &encoder_id,
+                               const uint8_t &decoder_id,
+                               const uint8_t &part_index,
+                               const uint8_t &scan_index)
+    {
+#if defined(TPPM_TAG_FEC)
+        return TPPMTagCode::encode(TAG_DATA(encoder_id, decoder_id, part_index, scan_index));
+#else
+        static const uint8_t tx_id_bits[] =
+        {
+            TPPMTag::TX_ID_BIT_0, TPPMTag::TX_ID_BIT_1, TPPMTag::TX_ID_BIT_2, TPPMTag::TX_ID_BIT_3,
+            TPPMTag::TX_ID_BIT_4, TPPMTag::TX_ID_BIT_5, TPPMTag::TX_ID_BIT_6, TPPMTag::TX_ID_BIT_7
+        };
+
+        static const uint8_t rx_id_bits[] =
+        {
+            TPPMTag::RX_ID_BIT_0    , TPPMTag::RX_ID_BIT_1    , TPPMTag::RX_ID_BIT_2    , TPPMTag::RX_ID_BIT_3    ,
+            TPPMTag::RX_SUB_ID_BIT_0, TPPMTag::RX_SUB_ID_BIT_1, TPPMTag::RX_SUB_ID_BIT_2, TPPMTag::RX_SUB_ID_BIT_3
+        };
+
+        static const uint8_t scan_bits[] =
+        {
+            TPPMTag::SCAN_BIT_0, TPPMTag::SCAN_BIT_1, TPPMTag::SCAN_BIT_2
+        };
+
+        uint32_t bits = 0;
+
+        // even parity on the encoder id, odd parity on the decoder id and on the scan index
+        //
+        if (put_field(bits, tx_id_bits, 8, encoder_id))
+        {
+            bits |= (uint32_t)1 << TPPMTag::TX_ID_EVEN_PARITY_BIT;
+        }
+
+        if (!put_field(bits, rx_id_bits, 8, (decoder_id & 0x0f) | ((part_index & 0x0f) << 4)))
+        {
+            bits |= (uint32_t)1 << TPPMTag::RX_ID_ODD_PARITY_BIT;
+        }
+
+        if (!put_field(bits, scan_bits, 3, scan_index))
+        {
+            bits |= (uint32_t)1 << TPPMTag::SCAN_ODD_PARITY_BIT;
+        }
+
+        return bits;
+#endif
+    }
+
+    // Returns the tag bits of the 8 channels layout for the given fields,
+    // parity bits included: even parity on the bits 0 of the pulses, odd
+    // parity on their bits 1
+    //
+    static inline uint32_t tag_8ch(const uint8_t &encoder_id,
+                                   const uint8_t &decoder_id,
+                                   const uint8_t &part_index,
+                                   const uint8_t &scan_index)
+    {
+        static const uint8_t bit0_positions[] =
+        {
+            TPPMTag::TAG8_TX_ID_BIT_0, TPPMTag::TAG8_TX_ID_BIT_1, TPPMTag::TAG8_TX_ID_BIT_2, TPPMTag::TAG8_TX_ID_BIT_3,
+            TPPMTag::TAG8_TX_ID_BIT_4, TPPMTag::TAG8_SCAN_BIT_0 , TPPMTag::TAG8_SCAN_BIT_1 , TPPMTag::TAG8_SCAN_BIT_2
+        };
+
+        static const uint8_t bit1_positions[] =
+        {
+            TPPMTag::TAG8_RX_ID_BIT_0    , TPPMTag::TAG8_RX_ID_BIT_1    , TPPMTag::TAG8_RX_ID_BIT_2    , TPPMTag::TAG8_RX_ID_BIT_3    ,
+            TPPMTag::TAG8_RX_SUB_ID_BIT_0, TPPMTag::TAG8_RX_SUB_ID_BIT_1, TPPMTag::TAG8_RX_SUB_ID_BIT_2, TPPMTag::TAG8_RX_SUB_ID_BIT_3
+        };
+
+        uint32_t bits = 0;
+
+        if (put_field(bits, bit0_positions, 8, (encoder_id & 0x1f) | ((scan_index & 0x07) << 5)))
+        {
+            bits |= (uint32_t)1 << TPPMTag::TAG8_EVEN_PARITY_BIT;
+        }
+
+        if (!put_field(bits, bit1_positions, 8, (decoder_id & 0x0f) | ((part_index & 0x0f) << 4)))
+        {
+            bits |= (uint32_t)1 << TPPMTag::TAG8_ODD_PARITY_BIT;
+        }
+
+        return bits;
+    }
+
+    // Build a tagged frame for the given receiver's sub-module.
+    //
+    // The scan index advances round robin on every frame, selecting which
+    // extra and on/off channels the frame carries.
+    //
+    // With TPPM_EXTENDED_ADDRESS the decoder id is 12 bits wide: when its
+    // page is not the selected one, or the page select is due again, the
+    // frame is a page select instead (see TPPMTag.h), with the same channels.
+    // Keep calling encode() for the receiver: the frames addressed to it
+    // follow the page select.
+    //
+    // - basic  : BASIC_CHANNELS_COUNT channels widths
+    // - extra  : EXTRA_CHANNELS_COUNT channels widths
+    // - onoff  : ONOFF_CHANNELS_BYTES bytes of on/off bits (the first
+    //            ONOFF_NIBBLE_CHANNELS bits in the 8 channels layout)
+    //
+    // A frame_period of 0 selects the layout's one.
+    //
+    inline void encode(Frame          &frame       ,
+                       const uint16_t &decoder_id  ,
+                       const uint8_t  &part_index  ,
+                       const uint16_t *basic       ,
+                       const uint16_t *extra       ,
+                       const uint8_t  *onoff       ,
+                       const uint32_t &frame_period = 0)
+    {
+        uint8_t rx_id  = decoder_id & 0x0f;
+        uint8_t sub_id = part_index;
+        bool    paging = false;
+
+#if defined(TPPM_EXTENDED_ADDRESS)
+        paging = page_due(decoder_id);
+#endif
+
+        if (_priority && !paging)
+        {
+            _scan_index = schedule(onoff);
+        }
+
+        uint8_t scan = _scan_index;
+
+#if defined(TPPM_EXTENDED_ADDRESS)
+        if (paging)
+        {
+            // A page select frame: a nibble of the page, and its sequence
+            // number in the scan index
+            //
+            rx_id  = EXTENDED_PAGE_ID;
+            sub_id = (_page >> (_page_step << 2)) & 0x0f;
+            scan   = _page_step++;
+        }
+#endif
+
+        bool     is_8ch = (TPPMTag::LAYOUT_8CH == _layout);
+        uint8_t  pulses = (is_8ch) ? ENCODER_8CH_PULSES : ENCODER_PULSES;
+        uint32_t bits   = (is_8ch) ? tag_8ch(_encoder_id, rx_id, sub_id, scan)
+                                   : tag    (_encoder_id, rx_id, sub_id, scan);
+
+        frame.channels = pulses - 1;
+
+#if defined(TPPM_TAG_8_LEVELS)
+        uint16_t half_bits = (_high_order) ? high_order_bits(pulses, onoff) : 0;
+#endif
+
+        for (uint8_t p=0; p<pulses; ++p)
+        {
+            frame.pulse_width[p] = SYMBOL_WIDTH(TPPMTag::symbol_bits(_layout, (bits >> (p << 1)) & 0x03));
+
+#if defined(TPPM_TAG_8_LEVELS)
+            if (_high_order)
+            {
+                frame.pulse_width[p] = HALF_SYMBOL_WIDTH(frame.pulse_width[p], BIT_VAL(half_bits, p));
+            }
+#endif
+        }
+
+        for (uint8_t c=0; c<BASIC_CHANNELS_COUNT; ++c)
+        {
+            frame.channel_width[c] = basic[c];
+        }
+
+        for (uint8_t c=0; c<MUXED_CHANNLES; ++c)
+        {
+            frame.channel_width[c+FIRST_EXTRA_CHANNEL] = extra[(_scan_index & 3) | (c << 2)];
+
+            if (!is_8ch)
+            {
+                uint8_t pair = onoff[ONOFF_SCAN_BYTE(c, _scan_index)] >> ((_scan_index & 3) << 1);
+
+                frame.channel_width[c+FIRST_ONOFF_CHANNEL] = ONOFF_WIDTH(pair & 0x03);
+            }
+        }
+
+        if (is_8ch)
+        {
+            uint8_t nibble = onoff[ONOFF_NIBBLE_BYTE(_scan_index)] >> ONOFF_NIBBLE_SHIFT(_scan_index);
+
+            frame.channel_width[FIRST_ONOFF_CHANNEL] = NIBBLE_WIDTH(nibble & 0x0f);
+
+            fill_sync(frame, (frame_period) ? frame_period : ENCODER_8CH_FRAME_PERIOD, ENCODER_8CH_MIN_SYNC);
+        }
+        else
+        {
+            fill_sync(frame, (frame_period) ? frame_period : ENCODER_FRAME_PERIOD);
+        }
+
+#if defined(TPPM_SYNC_SYMBOLS)
+        // The sync gap moves to the nearest width carrying the on/off channels
+        // of a further scan slot, the frame period is kept on average. A page
+        // select frame carries no symbol: its period is the nominal one, the
+        // clocks ratio estimate (see TPPMClock) is not moved by it
+        //
+        if (!paging)
+        {
+            quantise_sync(frame, sync_symbol(onoff_slot_bits(SYNC_SLOT(_scan_index), onoff)), (is_8ch) ? ENCODER_8CH_MIN_SYNC : MIN_SYNC_WIDTH);
+        }
+#endif
+
+        if (!_priority && !paging)
+        {
+            _scan_index = (_scan_index + 1) & (ONOFF_SCAN_SLOTS - 1);
+        }
+    }
+
+    // Build a plain PPM frame, all the pulses of the same width
+    //
+    static inline void plain(Frame          &frame       ,
+                             const uint16_t *channels    ,
+                             const uint8_t  &count       ,
+                             const uint16_t &pulse_width ,
+                             const uint32_t &frame_period)
+    {
+        frame.channels = count;
+
+        for (uint8_t c=0; c<count; ++c)
+        {
+            frame.channel_width[c] = channels[c];
+            frame.pulse_width  [c] = pulse_width;
+        }
+
+        frame.pulse_width[count] = pulse_width;
+
+        fill_sync(frame, frame_period);
+    }
+
+private:
+    uint8_t         _encoder_id;
+    uint8_t         _scan_index;
+    TPPMTag::Layout _layout    ;
+    bool            _priority  ;
+    uint8_t         _sent[ONOFF_SCAN_SLOTS]; // on/off bits last sent by each scan slot
+    uint8_t         _age [REFRESH_SLOTS   ]; // frames since each slot was sent
+
+    // Returns the slots refreshed by a frame with the scan index, as a bit
+    // mask (see TPPMTag::refreshed_slots())
+    //
+    inline uint16_t refreshed_slots(const uint8_t &scan_index)
+    {
+        uint16_t slots = (1 << scan_index) | (1 << EXTRA_REFRESH_SLOT(scan_index));
+
+#if defined(TPPM_TAG_8_LEVELS)
+        if (_high_order)
+        {
+            slots |= (1 << HIGH_ORDER_SLOT(scan_index));
+        }
+#endif
+
+#if defined(TPPM_SYNC_SYMBOLS)
+        slots |= (1 << SYNC_SLOT(scan_index));
+#endif
+
+        return slots;
+    }
+
+#if defined(TPPM_EXTENDED_ADDRESS)
+    uint8_t         _page       ; // the page selected
+    uint8_t         _page_step  ; // the page select frames sent
+    uint8_t         _page_frames; // the frames sent since the page select
+
+    // Returns true if the next frame is a page select: the decoder id's page
+    // is not selected, or it was selected EXTENDED_PAGE_PERIOD frames ago
+    //
+    inline bool page_due(const uint16_t &decoder_id)
+    {
+        uint8_t page = EXTENDED_PAGE(decoder_id);
+
+        if ((page != _page) || (_page_frames >= EXTENDED_PAGE_PERIOD))
+        {
+            _page        = page;
+            _page_step   = 0;
+            _page_frames = 0;
+        }
+
+        if (_page_step < EXTENDED_PAGE_FRAMES)
+        {
+            return true;
+        }
+
+        ++_page_frames;
+
+        return false;
+    }
+#endif
+
+    // Select the scan index of the next frame: the one refreshing the most
+    // stale slots, then the most changed slots, then the oldest slot
+    //
+    inline uint8_t schedule(const uint8_t *onoff)
+    {
+        uint8_t  best_scan  = 0;
+        uint16_t best_score = 0;
+
+        for (uint8_t scan=0; scan<ONOFF_SCAN_SLOTS; ++scan)
+        {
+            uint16_t slots   = refreshed_slots(scan);
+            uint8_t  stale   = 0;
+            uint8_t  changed = 0;
+            uint8_t  oldest  = 0;
+
+            for (uint8_t s=0; s<REFRESH_SLOTS; ++s)
+            {
+                if (slots & (1 << s))
+                {
+                    stale   += (_age[s] >= SCAN_MAX_AGE);
+                    changed += (s < ONOFF_SCAN_SLOTS) && (_sent[s] != onoff_slot_bits(s, onoff));
+                    oldest   = max(oldest, _age[s]);
+                }
+            }
+
+            uint16_t score = ((uint16_t)stale << 12) | ((uint16_t)changed << 8) | oldest;
+
+            if (score > best_score)
+            {
+                best_scan  = scan;
+                best_score = score;
+            }
+        }
+
+        uint16_t slots = refreshed_slots(best_scan);
+
+        for (uint8_t s=0; s<REFRESH_SLOTS; ++s)
+        {
+            if (slots & (1 << s))
+            {
+                if (s < ONOFF_SCAN_SLOTS)
+                {
+                    _sent[s] = onoff_slot_bits(s, onoff);
+                }
+
+                _age[s] = 0;
+            }
+            else
+            if (_age[s] < SCAN_MAX_AGE)
+            {
+                ++_age[s];
+            }
+        }
+
+        return best_scan;
+    }
+#if defined(TPPM_TAG_8_LEVELS)
+    bool            _high_order;
+
+    // Returns the third bits of the frame's pulses: the on/off channels of
+    // the second scan slot refreshed by the frame and their check
+    //
+    inline uint16_t high_order_bits(const uint8_t &pulses, const uint8_t *onoff)
+    {
+        uint8_t  data_bits = HIGH_ORDER_DATA_BITS(pulses);
+        uint16_t data      = onoff_slot_bits(HIGH_ORDER_SLOT(_scan_index), onoff);
+
+        return data | (TPPMTag::high_order_check(data | (_scan_index << data_bits)) << data_bits);
+    }
+#endif
+
+#if defined(TPPM_SYNC_SYMBOLS)
+    int32_t         _sync_debt ; // ticks the frames sent so far exceed their periods by
+
+    // Returns the sync gap symbol of the on/off channels data, its check in
+    // the low bits (see TPPMTag::sync_check())
+    //
+    inline uint8_t sync_symbol(const uint8_t &data)
+    {
+        return (data << TPPMTag::sync_check_bits(_layout)) | TPPMTag::sync_check(_layout, _scan_index);
+    }
+
+    // Move the sync gap to the nearest width carrying the symbol, never
+    // shorter than min_sync. The moves so far are paid back: the frame period
+    // is kept on average, the receiver clock reference (see
+    // TPPM_CLOCK_REFERENCE_US)
+    //
+    inline void quantise_sync(Frame &frame, const uint8_t &symbol, const uint16_t &min_sync)
+    {
+        int32_t width = (int32_t)frame.sync_width - _sync_debt;
+        int32_t steps = ((width > 0) ? width : 0) / SYNC_SYMBOL_STEP;
+        int32_t delta = ((int32_t)symbol - steps) & (SYNC_SYMBOL_LEVELS - 1);
+
+        if (delta >= (SYNC_SYMBOL_LEVELS / 2))
+        {
+            delta -= SYNC_SYMBOL_LEVELS;
+        }
+
+        steps += delta;
+
+        while ((steps * SYNC_SYMBOL_STEP) < min_sync)
+        {
+            steps += SYNC_SYMBOL_LEVELS;
+        }
+
+        _sync_debt += (steps * SYNC_SYMBOL_STEP) - frame.sync_width;
+
+        frame.sync_width = steps * SYNC_SYMBOL_STEP;
+    }
+#endif
+
+    // Returns the on/off channels bits of a scan slot laid out as the channels
+    // carry them: a nibble in the 8 channels layout, a pair for each
+    // multiplexed channel in the 10 channels one
+    //
+    inline uint8_t onoff_slot_bits(const uint8_t &slot, const uint8_t *onoff)
+    {
+        uint8_t bits = 0;
+
+        if (TPPMTag::LAYOUT_8CH == _layout)
+        {
+            return (onoff[ONOFF_NIBBLE_BYTE(slot)] >> ONOFF_NIBBLE_SHIFT(slot)) & 0x0f;
+        }
+
+        for (uint8_t c=0; c<MUXED_CHANNLES; ++c)
+        {
+            bits |= ((onoff[ONOFF_SCAN_BYTE(c, slot)] >> ((slot & 3) << 1)) & 0x03) << (c << 1);
+        }
+
+        return bits;
+    }
+
+    // Spread the value bits over the given tag bit positions, returns their parity
+    //
+    static inline uint8_t put_field(uint32_t      &bits     ,
+                                    const uint8_t *positions,
+                                    const uint8_t &count    ,
+                                    const uint8_t &value    )
+    {
+        uint8_t parity = 0;
+
+        for (uint8_t b=0; b<count; ++b)
+        {
+            if (BIT_VAL(value, b))
+            {
+                bits   |= (uint32_t)1 << positions[b];
+                parity ^= 1;
+            }
+        }
+
+        return parity;
+    }
+
+    // The sync gap completes the frame period, it is never shorter than
+    // min_sync
+    //
+    static inline void fill_sync(Frame          &frame                   ,
+                                 const uint32_t &frame_period            ,
+                                 const uint16_t &min_sync = MIN_SYNC_WIDTH)
+    {
+        uint32_t length = frame.pulse_width[frame.channels];
+
+        for (uint8_t c=0; c<frame.channels; ++c)
+        {
+            length += frame.channel_width[c];
+        }
+
+        frame.sync_width = ((length + min_sync) < frame_period) ? (frame_period - length) : min_sync;
+    }
+};
+
+#endif // __TPPM_ENCODER_H__
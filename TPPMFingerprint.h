@@ -0,0 +1,257 @@
+#if !defined(__TPPM_FINGERPRINT_H__)
+#define __TPPM_FINGERPRINT_H__
+
+#include "TPPMCfg.h"
+
+// Pulse slots of a frame: a pulse before each channel and one before the sync
+//
+#define FINGERPRINT_SLOTS          ( MAX_CHANNELS + 1 )
+
+// With TPPM_COMPACT_STORAGE all the pulse slots share a statistic, its
+// variance on 16 bits (a pulse standard deviation up to 255 ticks): the
+// fingerprint shrinks from 17 statistics to 3
+//
+#if defined(TPPM_COMPACT_STORAGE)
+#define FINGERPRINT_PULSE_STATISTICS  1
+#define PULSE_STATISTIC(slot)         0
+#else
+#define FINGERPRINT_PULSE_STATISTICS  FINGERPRINT_SLOTS
+#define PULSE_STATISTIC(slot)         ( (slot) - 1 )
+#endif
+
+// Running averages weights: 1/4 of the new frame
+//
+#define FINGERPRINT_AVERAGE_SHIFT  2
+
+// A width matches if within 4 standard deviations from its mean: the squared
+// error is compared with the variance times 2^FINGERPRINT_SIGMAS_SHIFT
+//
+#define FINGERPRINT_SIGMAS_SHIFT   4
+
+// Standard deviations floors, the variances learned are never below their
+// square: the transmitter and the Timer1 jitter on the pulses, the stick
+// motion between two frames on the frame period (or on the sync gap for
+// transmitters with a fixed sync gap). The sync gap symbols move both by up
+// to +/-1 ms (see TPPM_SYNC_SYMBOLS).
+//
+#define FINGERPRINT_PULSE_JITTER   USEC_TO_WIDTH( 5 )
+
+#if defined(TPPM_SYNC_SYMBOLS)
+#define FINGERPRINT_FRAME_JITTER   USEC_TO_WIDTH( 600 )
+#else
+#define FINGERPRINT_FRAME_JITTER   USEC_TO_WIDTH( 100 )
+#endif
+
+// Variances ceiling, ticks^2: keeps the tolerance arithmetic within 32 bits
+//
+#define FINGERPRINT_MAX_VARIANCE   0x00ffffffUL
+
+// The statistical fingerprint of a transmitter: the channels count and the
+// running mean and variance of every pulse slot width, of the frame period
+// and of the sync gap width, learned from the frames it accepts.
+//
+// A frame matches if it has the same channels count, all its pulses are
+// within the tolerance of their slot and either its period (fixed frame rate
+// transmitters) or its sync gap (fixed sync gap transmitters) is within the
+// tolerance of theirs: the channels widths, moved by the sticks, are not part
+// of it. The tolerances are derived from the variances, so a jittery
+// transmitter is matched as reliably as a clean one.
+//
+// The pulses of a tagged frame carry the tag symbols, not the transmitter's
+// pulse width: their slots are not checked, the tag check and its encoder id
+// identify the transmitter instead (see TPPMTag).
+//
+class TPPMFingerprint
+{
+public:
+    TPPMFingerprint()
+    {
+        reset();
+    }
+
+    // Forget the transmitter, the next frame is learned as it is
+    //
+    inline void reset()
+    {
+        _frames       = 0;
+        _channels     = 0;
+        _pulses_match = true;
+    }
+
+    // Account a pulse of the frame being captured, slots are 1 based
+    //
+    inline void pulse(const uint8_t &slot, const uint16_t &width)
+    {
+        if (!IS_IN_RANGE(slot, 1, FINGERPRINT_SLOTS))
+        {
+            return;
+        }
+
+        PulseStatistic &statistic = _pulse[PULSE_STATISTIC(slot)];
+
+        if (0 == _frames)
+        {
+            if ((1 == slot) || (FINGERPRINT_PULSE_STATISTICS > 1))
+            {
+                statistic.start(width, FINGERPRINT_PULSE_JITTER);
+            }
+            else
+            {
+                statistic.track(width, FINGERPRINT_PULSE_JITTER);
+            }
+        }
+        else
+        if (slot > (_channels + 1))
+        {
+            _pulses_match = false;
+        }
+        else
+        {
+            _pulses_match = statistic.matches(width) && _pulses_match;
+
+            statistic.track(width, FINGERPRINT_PULSE_JITTER);
+        }
+    }
+
+    // Account the frame ended at the sync gap, returns true if it matches the
+    // fingerprint (the first frame always does, it is learned)
+    //
+    inline bool frame(const uint8_t  &channels    ,
+                      const uint16_t &frame_period,
+                      const uint16_t &sync_width  ,
+                      const bool     &tagged      )
+    {
+        bool match = true;
+
+        if (0 == _frames)
+        {
+            _channels = channels;
+
+            _period.start(frame_period, FINGERPRINT_FRAME_JITTER);
+            _sync  .start(sync_width  , FINGERPRINT_FRAME_JITTER);
+        }
+        else
+        {
+            match = (channels == _channels)
+                    &&
+                    (tagged || _pulses_match)
+                    &&
+                    (_period.matches(frame_period) || _sync.matches(sync_width));
+
+            if (match)
+            {
+                _period.track(frame_period, FINGERPRINT_FRAME_JITTER);
+                _sync  .track(sync_width  , FINGERPRINT_FRAME_JITTER);
+            }
+        }
+
+        if (match && (_frames < 0xff))
+        {
+            ++_frames;
+        }
+
+        // Start checking the next frame's pulses
+        //
+        _pulses_match = true;
+
+        return match;
+    }
+
+    // Returns the frames learned since the last reset(), up to 255
+    //
+    inline uint8_t frames()
+    {
+        return _frames;
+    }
+
+    inline uint8_t channels()
+    {
+        return _channels;
+    }
+
+    // Returns true if the other fingerprint was learned from this transmitter:
+    // the same channels count, the other pulses means (not for a tagged one,
+    // see frame()) and its frame period or sync gap mean within the tolerances
+    // of this one
+    //
+    inline bool same(const TPPMFingerprint &other, const bool &tagged)
+    {
+        if ((0 == _frames) || (0 == other._frames) || (other._channels != _channels))
+        {
+            return false;
+        }
+
+        if (!tagged)
+        {
+            for (uint8_t s=0; s<min(_channels + 1, FINGERPRINT_PULSE_STATISTICS); ++s)
+            {
+                if (!_pulse[s].matches(other._pulse[s].mean))
+                {
+                    return false;
+                }
+            }
+        }
+
+        return _period.matches(other._period.mean) || _sync.matches(other._sync.mean);
+    }
+
+private:
+    // Running mean and variance of a width, Timer1 ticks
+    //
+    template <typename Variance>
+    struct Statistic
+    {
+        uint16_t mean    ;
+        Variance variance; // ticks^2, up to FINGERPRINT_MAX_VARIANCE
+
+        inline void start(const uint16_t &width, const uint16_t &jitter)
+        {
+            mean     = width;
+            variance = (uint32_t)jitter * jitter;
+        }
+
+        inline bool matches(const uint16_t &width)
+        {
+            uint32_t error = (width > mean) ? (width - mean) : (mean - width);
+
+            return (error * error) <= ((uint32_t)variance << FINGERPRINT_SIGMAS_SHIFT);
+        }
+
+        inline void track(const uint16_t &width, const uint16_t &jitter)
+        {
+            int32_t  error  = (int32_t)width - mean;
+            uint32_t square = (uint32_t)error * error;
+            uint32_t floor  = (uint32_t)jitter * jitter;
+
+            uint32_t ceiling = min(FINGERPRINT_MAX_VARIANCE, (uint32_t)(Variance)~0);
+
+            if (square > ceiling)
+            {
+                square = ceiling;
+            }
+
+            mean     += error >> FINGERPRINT_AVERAGE_SHIFT;
+            variance += ((int32_t)square - (int32_t)variance) >> FINGERPRINT_AVERAGE_SHIFT;
+
+            if (variance < floor)
+            {
+                variance = floor;
+            }
+        }
+    };
+
+#if defined(TPPM_COMPACT_STORAGE)
+    typedef Statistic<uint16_t> PulseStatistic;
+#else
+    typedef Statistic<uint32_t> PulseStatistic;
+#endif
+
+    uint8_t             _frames                  ; // learned
+    uint8_t             _channels                ;
+    bool                _pulses_match            ; // so far, in the frame being captured
+    PulseStatistic      _pulse[FINGERPRINT_PULSE_STATISTICS];
+    Statistic<uint32_t> _period                  ;
+    Statistic<uint32_t> _sync                    ;
+};
+
+#endif // __TPPM_FINGERPRINT_H__
@@ -0,0 +1,251 @@
+#if !defined(__TPPM_LEVELS_H__)
+#define __TPPM_LEVELS_H__
+
+#include "TPPMCfg.h"
+
+#define CODE_LEVELS               4
+
+#define MIN_CODE_THRESHOLD        USEC_TO_WIDTH( 300 ) // MIN_PULSE_WIDTH
+#define MAX_CODE_THRESHOLD        USEC_TO_WIDTH( 460 ) // MAX_PULSE_WIDTH
+#define CODE_THRESHOLD_STEP       ( ( MAX_CODE_THRESHOLD - MIN_CODE_THRESHOLD ) / CODE_LEVELS )
+
+// The symbol levels centroids are kept in fixed point with LEVEL_FRACTION_BITS
+// fractional bits
+//
+#define LEVEL_FRACTION_BITS       4
+#define LEVEL_ONE                 ( 1 << LEVEL_FRACTION_BITS )
+
+// Exponential moving average weights of a new pulse width: 1/4 while learning
+// (ACKNOWLEDGE), 1/32 afterwards to track the slow drift only. The widths of a
+// frame are summed and only applied once its tag is found valid (see apply())
+//
+#define LEVEL_LEARN_SHIFT         2
+#define LEVEL_TRACK_SHIFT         5
+
+// A learned level can not move farther than one step from its nominal value,
+// nor closer than half a step to its neighbours
+//
+#define MAX_LEVEL_DRIFT           ( CODE_THRESHOLD_STEP * LEVEL_ONE )
+#define MIN_LEVEL_SPACING         ( ( CODE_THRESHOLD_STEP * LEVEL_ONE ) / 2 )
+
+#define NOMINAL_LEVEL(symbol)     ( ( MIN_CODE_THRESHOLD + ( CODE_THRESHOLD_STEP * (symbol) ) + ( CODE_THRESHOLD_STEP / 2 ) ) * LEVEL_ONE )
+
+// The symbol levels superimposed to the pulses, learned from the widths of the
+// transmitter pulses.
+//
+// Each level is the centroid of the pulse widths quantized to it, the
+// thresholds lie halfway between adjacent centroids:
+//
+//                    level 0     level 1     level 2     level 3
+//        |                 o     |     o     |     o     |     o                 |
+//        |<--- 1 step ---->|     |           |           |     |<--- 1 step ---->|
+//   threshold[0]            threshold[1] threshold[2] threshold[3]          threshold[4]
+//
+// so a transmitter clock offset or a receiver filter skew moves the thresholds
+// along with the pulse widths instead of pushing the symbols across them.
+//
+class TPPMLevels
+{
+public:
+    TPPMLevels()
+    {
+        reset();
+    }
+
+    // Forget the learned levels and restart from the nominal ones
+    //
+    inline void reset()
+    {
+        for (uint8_t l=0; l<CODE_LEVELS; ++l)
+        {
+            _centroid[l] = NOMINAL_LEVEL(l);
+        }
+
+        _learning = true;
+
+        discard();
+
+        update_thresholds();
+    }
+
+    // Learn fast (true) or just track the slow drift (false)
+    //
+    inline void learn(const bool &learning)
+    {
+        _learning = learning;
+    }
+
+    // Returns true if the width can carry a symbol
+    //
+    inline bool is_symbol(const uint16_t &width)
+    {
+        return IS_IN_RANGE(width, _threshold[0], _threshold[CODE_LEVELS]);
+    }
+
+    // Returns the symbol carried by the width
+    //
+    inline uint8_t quantize(const uint16_t &width)
+    {
+        uint8_t symbol = CODE_LEVELS - 1;
+
+        while ((symbol > 0) && (width < _threshold[symbol]))
+        {
+            --symbol;
+        }
+
+        return symbol;
+    }
+
+    // Account the width just quantized to the symbol: its level moves toward
+    // it with apply(), once the frame's tag is checked
+    //
+    inline void track(const uint16_t &width, const uint8_t &symbol)
+    {
+        _errors[symbol] += (int16_t)((width << LEVEL_FRACTION_BITS) - _centroid[symbol]);
+
+        ++_widths[symbol];
+    }
+
+    // Forget the widths accounted since the last apply(): the frame carried
+    // no valid tag, or a corrected one
+    //
+    inline void discard()
+    {
+        for (uint8_t l=0; l<CODE_LEVELS; ++l)
+        {
+            _errors[l] = 0;
+            _widths[l] = 0;
+        }
+    }
+
+    // Move the symbol levels toward the widths accounted in the frame, as
+    // many moving average steps as widths: a step each with their sum, with
+    // their mean if that would overshoot it
+    //
+    inline void apply()
+    {
+        uint8_t shift = _learning ? LEVEL_LEARN_SHIFT : LEVEL_TRACK_SHIFT;
+
+        for (uint8_t l=0; l<CODE_LEVELS; ++l)
+        {
+            if (0 != _widths[l])
+            {
+                move(l, (_widths[l] > (1 << shift)) ? (_errors[l] / _widths[l]) : (_errors[l] >> shift));
+            }
+        }
+
+        discard();
+    }
+
+    // Returns the distance of the width from the nearest threshold of its symbol
+    //
+    inline uint16_t margin(const uint16_t &width, const uint8_t &symbol)
+    {
+        uint16_t below = width - _threshold[symbol];
+        uint16_t above = _threshold[symbol + 1] - width;
+
+        return (below < above) ? below : above;
+    }
+
+    // Returns the distance of the width from the nearest threshold between its
+    // symbol and a neighbour one, and that neighbour symbol
+    //
+    inline uint16_t confidence(const uint16_t &width, const uint8_t &symbol, uint8_t &neighbour)
+    {
+        uint16_t below = (symbol > 0              ) ? (width - _threshold[symbol    ]) : 0xffff;
+        uint16_t above = (symbol < CODE_LEVELS - 1) ? (_threshold[symbol + 1] - width) : 0xffff;
+
+        neighbour = (below < above) ? (symbol - 1) : (symbol + 1);
+
+        return (below < above) ? below : above;
+    }
+
+    // Returns the half of the symbol level the width lies in, 1 for the upper
+    // one, and the distance of the width from the level (see TPPM_TAG_8_LEVELS)
+    //
+    inline uint8_t half(const uint16_t &width, const uint8_t &symbol, uint16_t &margin)
+    {
+        uint16_t center = level(symbol);
+
+        if (width >= center)
+        {
+            margin = width - center;
+
+            return 1;
+        }
+
+        margin = center - width;
+
+        return 0;
+    }
+
+    inline uint16_t threshold(const uint8_t &index)
+    {
+        return _threshold[index];
+    }
+
+    inline uint16_t level(const uint8_t &symbol)
+    {
+        return _centroid[symbol] >> LEVEL_FRACTION_BITS;
+    }
+
+private:
+    uint16_t _centroid [CODE_LEVELS    ]; // fixed point, LEVEL_FRACTION_BITS
+    uint16_t _threshold[CODE_LEVELS + 1]; // timer ticks
+    int16_t  _errors   [CODE_LEVELS    ]; // summed widths errors of the frame, fixed point
+    uint8_t  _widths   [CODE_LEVELS    ]; // widths summed
+    bool     _learning ;
+
+    // Move the symbol level by the step, within its drift and spacing bounds
+    //
+    inline void move(const uint8_t &symbol, const int16_t &step)
+    {
+        uint16_t centroid = _centroid[symbol] + step;
+
+        uint16_t lower = NOMINAL_LEVEL(symbol) - MAX_LEVEL_DRIFT;
+        uint16_t upper = NOMINAL_LEVEL(symbol) + MAX_LEVEL_DRIFT;
+
+        if (symbol > 0)
+        {
+            lower = max(lower, (uint16_t)(_centroid[symbol - 1] + MIN_LEVEL_SPACING));
+        }
+
+        if (symbol < (CODE_LEVELS - 1))
+        {
+            upper = min(upper, (uint16_t)(_centroid[symbol + 1] - MIN_LEVEL_SPACING));
+        }
+
+        if (centroid < lower)
+        {
+            centroid = lower;
+        }
+        else
+        if (centroid > upper)
+        {
+            centroid = upper;
+        }
+
+        if (centroid != _centroid[symbol])
+        {
+            _centroid[symbol] = centroid;
+
+            update_thresholds();
+        }
+    }
+
+    inline void update_thresholds()
+    {
+        for (uint8_t l=1; l<CODE_LEVELS; ++l)
+        {
+            _threshold[l] = (_centroid[l - 1] + _centroid[l]) >> (LEVEL_FRACTION_BITS + 1);
+        }
+
+        // The outer thresholds are one full step away from the outer levels,
+        // tolerating pulses pushed out of the nominal range by the skew
+        //
+        _threshold[0          ] = (_centroid[0              ] >> LEVEL_FRACTION_BITS) - CODE_THRESHOLD_STEP;
+        _threshold[CODE_LEVELS] = (_centroid[CODE_LEVELS - 1] >> LEVEL_FRACTION_BITS) + CODE_THRESHOLD_STEP;
+    }
+};
+
+#endif // __TPPM_LEVELS_H__
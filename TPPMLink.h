@@ -0,0 +1,148 @@
+#if !defined(__TPPM_LINK_H__)
+#define __TPPM_LINK_H__
+
+#include "TPPMLevels.h"
+
+// Number of frames the good frames ratio is computed on (up to 32)
+//
+#define LINK_HISTORY_FRAMES   32
+
+// Exponential moving averages weights: 1/8 of the new frame
+//
+#define LINK_AVERAGE_SHIFT    3
+
+// Symbol margin giving full score, half a symbol step is the best possible one
+//
+#define LINK_FULL_MARGIN      ( CODE_THRESHOLD_STEP / 2 )
+
+namespace TPPM
+{
+    struct LinkQuality
+    {
+        uint16_t frame_period     ; // averaged frame period, Timer1 ticks
+        uint8_t  frames_per_second; // from the averaged frame period
+        uint8_t  good_frames_ratio; // good frames over the last LINK_HISTORY_FRAMES, 0..255
+        uint16_t width_variance   ; // variance of the frame mean pulse width, ticks^2
+        uint16_t symbol_margin    ; // averaged worst tag symbol distance from its thresholds, ticks
+        uint8_t  score            ; // 0 (no link) .. 255 (perfect link)
+    };
+};
+
+// The link quality indicators, updated once per frame at the sync gap from
+// the data the decoder has already collected: no per edge work.
+//
+class TPPMLink
+{
+public:
+    TPPMLink()
+    {
+        reset();
+    }
+
+    inline void reset()
+    {
+        _history       = 0;
+        _good_frames   = 0;
+        _frame_period  = 0;
+        _mean_width    = 0;
+        _variance      = 0;
+        _symbol_margin = LINK_FULL_MARGIN;
+    }
+
+    // Account a frame, good or not.
+    //
+    // - frame_period : sync to sync, Timer1 ticks
+    // - mean_width   : mean pulse width of the frame, Timer1 ticks
+    // - margin       : worst tag symbol margin of the frame, LINK_FULL_MARGIN if not tagged
+    //
+    inline void frame(const bool     &good        ,
+                      const uint16_t &frame_period,
+                      const uint16_t &mean_width  ,
+                      const uint16_t &margin      )
+    {
+        // Good frames ratio: slide the window by one frame
+        //
+        _good_frames -= (_history >> (LINK_HISTORY_FRAMES - 1)) & 0x01;
+        _history      = (_history << 1) | (good ? 1 : 0);
+        _good_frames += (good ? 1 : 0);
+
+        // Frame rate
+        //
+        if (0 == _frame_period)
+        {
+            _frame_period = frame_period;
+        }
+        else
+        {
+            _frame_period += ((int32_t)frame_period - _frame_period) >> LINK_AVERAGE_SHIFT;
+        }
+
+        if (good)
+        {
+            // Pulse width jitter, only meaningful on good frames
+            //
+            if (0 == _mean_width)
+            {
+                _mean_width = mean_width;
+            }
+
+            int16_t  delta  = (int16_t)(mean_width - _mean_width);
+            uint32_t square = (int32_t)delta * delta;
+
+            if (square > 0xffff)
+            {
+                square = 0xffff;
+            }
+
+            _mean_width += delta >> LINK_AVERAGE_SHIFT;
+            _variance   += ((int32_t)square - _variance) >> LINK_AVERAGE_SHIFT;
+
+            // Tag symbols margin
+            //
+            _symbol_margin += ((int32_t)margin - _symbol_margin) >> LINK_AVERAGE_SHIFT;
+        }
+    }
+
+    // Fill the link quality indicators. Divides: do not call from the ISR.
+    //
+    inline void get(TPPM::LinkQuality &quality)
+    {
+        quality.frame_period      = _frame_period;
+        quality.frames_per_second = (0 == _frame_period) ? 0 : ((TICKS_PER_MS * 1000UL) + (_frame_period >> 1)) / _frame_period;
+        quality.good_frames_ratio = ((uint16_t)_good_frames * 255) / LINK_HISTORY_FRAMES;
+        quality.width_variance    = _variance;
+        quality.symbol_margin     = _symbol_margin;
+
+        uint16_t margin = (_symbol_margin < LINK_FULL_MARGIN) ? _symbol_margin : LINK_FULL_MARGIN;
+
+        quality.score = ((uint32_t)quality.good_frames_ratio * margin) / LINK_FULL_MARGIN;
+    }
+
+    // Returns the good frames history, one bit per frame, the last frame in bit 0
+    //
+    inline uint32_t history()
+    {
+        return _history;
+    }
+
+    // Returns the combined score, 0 (no link) .. 255 (perfect link)
+    //
+    inline uint8_t score()
+    {
+        TPPM::LinkQuality quality;
+
+        get(quality);
+
+        return quality.score;
+    }
+
+private:
+    uint32_t _history      ; // one bit per frame, 1: good
+    uint8_t  _good_frames  ; // bits set in _history
+    uint16_t _frame_period ;
+    uint16_t _mean_width   ;
+    uint16_t _variance     ;
+    uint16_t _symbol_margin;
+};
+
+#endif // __TPPM_LINK_H__
@@ -0,0 +1,247 @@
+#if !defined(__TPPM_LOCK_H__)
+#define __TPPM_LOCK_H__
+
+#include <avr/eeprom.h>
+
+#include "TPPMSum.h"
+
+// EEPROM area reserved to the lock record, at the end of the EEPROM by
+// default (the flight recorder ring stops before it)
+//
+#if !defined(LOCK_EEPROM_SIZE)
+#define LOCK_EEPROM_SIZE        256
+#endif
+
+#if !defined(LOCK_EEPROM_START)
+#define LOCK_EEPROM_START       ( E2END + 1 - LOCK_EEPROM_SIZE )
+#endif
+
+// Lock record layout:
+//
+//   +--------+---------+----------------+------------+
+//   | magic  |  size   |      lock      |  checksum  |
+//   | 1 byte | 2 bytes | TPPM::Lock     |  2 bytes   |
+//   +--------+---------+----------------+------------+
+//
+// The magic is cleared before the record is written and written back last:
+// a record partially written by a reset is never loaded. The size rejects the
+// records of a firmware built with a different configuration.
+//
+#define LOCK_MAGIC              0x4c
+#define LOCK_HEADER_SIZE        3
+#define LOCK_CHECKSUM_SIZE      2
+#define LOCK_RECORD_SIZE        ( LOCK_HEADER_SIZE + sizeof(TPPM::Lock) + LOCK_CHECKSUM_SIZE )
+
+static_assert(LOCK_RECORD_SIZE <= LOCK_EEPROM_SIZE, "The lock record does not fit in LOCK_EEPROM_SIZE");
+
+// Minimum interval between the starts of two records, Timer1 ticks: a link
+// flapping between two transmitters writes a record a minute at most, the
+// last lock
+//
+#if !defined(LOCK_INTERVAL)
+#define LOCK_INTERVAL           MSEC_TO_WIDTH( 60000UL )
+#endif
+
+// Writing progress when nothing is to be written, and when a record waits for
+// LOCK_INTERVAL
+//
+#define LOCK_IDLE               0xffff
+#define LOCK_WAITING            0xfffe
+
+// The lock on the transmitter persisted in the EEPROM, to lock on it again
+// right after a reset (see TPPMSum::warm_start()): an in flight brownout
+// costs a couple of frames instead of the whole acquisition, and the fail
+// safe frame is output meanwhile.
+//
+// As the flight recorder, nothing is done in the ISR: update() polls the
+// decoder from the sketch's loop() and takes a copy of every new lock,
+// service() writes it one byte at a time, only when the EEPROM is ready.
+//
+// The record is fixed in the EEPROM, so it is only written when the coupled
+// encoder id, the pulse level or the fingerprint differ from the persisted
+// ones, and at most once every LOCK_INTERVAL: a decoder locking again on the
+// same transmitter writes nothing. Only the bytes changed are written.
+//
+class TPPMLock
+{
+public:
+    TPPMLock()
+        : _locks   (0)
+        , _written (false)
+        , _progress(LOCK_IDLE)
+        , _checksum(0)
+        , _started (0)
+    {}
+
+    // Warm start the decoder from the persisted lock, if any: call it after
+    // TPPMSum::init(), returns true if the decoder was warm started
+    //
+    inline bool begin(TPPMSum &decoder)
+    {
+        _locks = decoder.locks();
+
+        if (!load(_lock))
+        {
+            return false;
+        }
+
+        decoder.warm_start(_lock);
+
+        return true;
+    }
+
+    // Take a copy of the decoder's lock when it locks on another transmitter
+    //
+    inline void update(TPPMSum &decoder)
+    {
+        uint8_t locks = decoder.locks();
+
+        // A record being written is completed first, the locks since then are
+        // taken afterwards: a flapping link can not keep it from completing
+        //
+        if (_progress < LOCK_WAITING)
+        {
+            return;
+        }
+
+        if ((locks != _locks) && decoder.lock_state(_lock))
+        {
+            _locks    = locks;
+            _progress = persisted(_lock) ? LOCK_IDLE : LOCK_WAITING;
+        }
+    }
+
+    // Write the next byte of the lock record, if any and the EEPROM is ready
+    //
+    inline void service()
+    {
+        if (idle() || !eeprom_is_ready())
+        {
+            return;
+        }
+
+        if (LOCK_WAITING == _progress)
+        {
+            uint32_t now = TPPMSum::capture_clock();
+
+            if (_written && ((now - _started) < LOCK_INTERVAL))
+            {
+                return;
+            }
+
+            _written  = true;
+            _started  = now;
+            _progress = 0;
+            _checksum = 0;
+        }
+
+        const uint8_t *lock = (const uint8_t *)&_lock;
+
+        if (0 == _progress)
+        {
+            eeprom_update_byte(address(0), 0);
+        }
+        else
+        if (_progress < LOCK_HEADER_SIZE)
+        {
+            eeprom_update_byte(address(_progress), (uint8_t)(sizeof(TPPM::Lock) >> ((_progress - 1) << 3)));
+        }
+        else
+        if (_progress < (LOCK_HEADER_SIZE + sizeof(TPPM::Lock)))
+        {
+            uint8_t value = lock[_progress - LOCK_HEADER_SIZE];
+
+            _checksum = checksum(_checksum, value);
+
+            eeprom_update_byte(address(_progress), value);
+        }
+        else
+        if (_progress < LOCK_RECORD_SIZE)
+        {
+            eeprom_update_byte(address(_progress), (uint8_t)(_checksum >> ((_progress - LOCK_HEADER_SIZE - sizeof(TPPM::Lock)) << 3)));
+        }
+        else
+        {
+            eeprom_update_byte(address(0), LOCK_MAGIC);
+
+            _progress = LOCK_IDLE;
+
+            return;
+        }
+
+        ++_progress;
+    }
+
+    // Returns true if nothing is waiting to be written
+    //
+    inline bool idle()
+    {
+        return LOCK_IDLE == _progress;
+    }
+
+    // Read the persisted lock, returns false if there is none or it is corrupted
+    //
+    static inline bool load(TPPM::Lock &lock)
+    {
+        uint8_t  *bytes = (uint8_t *)&lock;
+        uint16_t  sum   = 0;
+
+        if ((LOCK_MAGIC != eeprom_read_byte(address(0)))
+            ||
+            (sizeof(TPPM::Lock) != (eeprom_read_byte(address(1)) | ((uint16_t)eeprom_read_byte(address(2)) << 8))))
+        {
+            return false;
+        }
+
+        for (uint16_t b=0; b<sizeof(TPPM::Lock); ++b)
+        {
+            bytes[b] = eeprom_read_byte(address(LOCK_HEADER_SIZE + b));
+
+            sum = checksum(sum, bytes[b]);
+        }
+
+        uint16_t stored = eeprom_read_byte(address(LOCK_HEADER_SIZE + sizeof(TPPM::Lock)    ))
+                          |
+                          ((uint16_t)eeprom_read_byte(address(LOCK_HEADER_SIZE + sizeof(TPPM::Lock) + 1)) << 8);
+
+        return (stored == sum);
+    }
+
+private:
+    TPPM::Lock _lock    ; // being written, or loaded
+    uint8_t    _locks   ; // decoder's locks counter at the last update()
+    bool       _written ; // a record was started since begin()
+    uint16_t   _progress; // next byte of the record to write
+    uint16_t   _checksum;
+    uint32_t   _started ; // capture clock at the start of the last record
+
+    // Returns true if the persisted record already holds the transmitter of
+    // the lock (loaded on the stack: a TPPM::Lock more, for a moment)
+    //
+    static inline bool persisted(TPPM::Lock &lock)
+    {
+        TPPM::Lock stored;
+
+        return load(stored)
+               &&
+               (stored.coupled_id  == lock.coupled_id )
+               &&
+               (stored.pulse_level == lock.pulse_level)
+               &&
+               stored.fingerprint.same(lock.fingerprint, 0 != lock.coupled_id);
+    }
+
+    static inline uint8_t *address(const uint16_t &offset)
+    {
+        return (uint8_t *)(size_t)(LOCK_EEPROM_START + offset);
+    }
+
+    // Rotate and xor: any single byte change, and most swaps, are detected
+    //
+    static inline uint16_t checksum(const uint16_t &sum, const uint8_t &value)
+    {
+        return ((sum << 1) | (sum >> 15)) ^ value;
+    }
+};
+
+#endif // __TPPM_LOCK_H__
@@ -0,0 +1,371 @@
+#if !defined(__TPPM_MODULE_H__)
+#define __TPPM_MODULE_H__
+
+#include "TPPMTag.h"
+
+// Number of sub-modules channels tables kept by the decoder, a power of 2 up
+// to SUB_MODULES.
+//
+// With less tables than SUB_MODULES, the sub-modules share the tables modulo
+// MODULE_TABLES: a single table overwritten by every sub-module by default on
+// the small RAM parts.
+//
+#if !defined(MODULE_TABLES)
+#if defined(TPPM_COMPACT_STORAGE)
+#define MODULE_TABLES          1
+#else
+#define MODULE_TABLES          SUB_MODULES
+#endif
+#endif
+
+#if ( MODULE_TABLES & ( MODULE_TABLES - 1 ) ) || ( MODULE_TABLES > SUB_MODULES )
+#error "MODULE_TABLES must be a power of 2 up to SUB_MODULES"
+#endif
+
+#define MODULE_TABLE(part_index) ( (part_index) & ( MODULE_TABLES - 1 ) )
+
+// Age of a channel never refreshed since the decoder initialization
+//
+#define NEVER_REFRESHED        ( (TPPM::FrameStamp)~0 )
+
+// The channels ages saturate here, half the frame stamps range: the frame
+// stamps wrap around, so a slot is marked stale by TPPMModule::age() once its
+// age exceeds MAX_SLOT_AGE, well before it could look fresh again
+//
+#define MAX_SLOT_AGE           ( (TPPM::FrameStamp)( NEVER_REFRESHED >> 1 ) )
+
+static_assert(MAX_SLOT_AGE + MODULE_TABLES < NEVER_REFRESHED, "The tables are not aged often enough for the frame stamps range");
+
+#define ALL_SCAN_SLOTS         ( ( 1 << REFRESH_SLOTS ) - 1 )
+
+// The predictor weighs the last refresh step of an extra channel by the
+// progress of its scan slot toward the next refresh, kept in fixed point with
+// PREDICT_FRACTION_BITS fractional bits (see TPPM_EXTRA_PREDICTOR)
+//
+#define PREDICT_FRACTION_BITS  8
+#define PREDICT_ONE            ( 1 << PREDICT_FRACTION_BITS )
+
+// The extra and on/off channels of a sub-module, updated by the superimposed
+// tag's scan index of the frames addressed to it.
+//
+// Each extra and on/off scan slot records the frame at which it was last
+// refreshed (see REFRESH_SLOTS), so the age of any channel and the length of
+// a full multiplex cycle (all the slots refreshed) are known.
+//
+class TPPMModule
+{
+public:
+    TPPMModule()
+        : _generation  (0)
+        , _scan_slots  (0)
+        , _cycle_slots (0)
+        , _stale_slots (0)
+        , _cycle_start (0)
+        , _cycle_frames(0)
+#if defined(TPPM_EXTRA_PREDICTOR)
+        , _extra_slots (0)
+        , _predictable (0)
+#endif
+    {}
+
+    // Set all the channels to their default values
+    //
+    inline void reset(const uint16_t &default_servo_value,
+                      const bool     &default_onoff_value)
+    {
+        for (uint8_t c=0; c<EXTRA_CHANNELS_COUNT; ++c)
+        {
+            TPPM::set_channel(_extra_channels, c, default_servo_value);
+        }
+
+        for (uint8_t c=0; c<ONOFF_CHANNELS_BYTES; ++c)
+        {
+            _onoff_channels[c] = (default_onoff_value) ? 0xff : 0x00;
+        }
+
+        _generation   = 0;
+        _scan_slots   = 0;
+        _cycle_slots  = 0;
+        _stale_slots  = 0;
+        _cycle_start  = 0;
+        _cycle_frames = 0;
+
+#if defined(TPPM_EXTRA_PREDICTOR)
+        _extra_slots  = 0;
+        _predictable  = 0;
+#endif
+    }
+
+    // A frame addressed to this sub-module has been decoded into its channels
+    //
+    // - slots : the slots refreshed by the frame, a bit mask (see
+    //           TPPMTag::refreshed_slots())
+    // - now   : the frame stamp of the frame
+    //
+    inline void refreshed(const uint16_t &slots, const TPPM::FrameStamp &now)
+    {
+        ++_generation;
+
+        for (uint8_t slot=0; slot<REFRESH_SLOTS; ++slot)
+        {
+            if (slots & (1 << slot))
+            {
+                _refresh_stamp[slot] = now;
+            }
+        }
+
+        if (0 == _cycle_slots)
+        {
+            _cycle_start = now;
+        }
+
+        _scan_slots  |= slots;
+        _cycle_slots |= slots;
+        _stale_slots &= ~slots;
+
+        if (ALL_SCAN_SLOTS == _cycle_slots)
+        {
+            // All the channels have been refreshed: a full multiplex cycle
+            //
+            _cycle_frames = now - _cycle_start + 1;
+            _cycle_slots  = 0;
+        }
+    }
+
+    // Mark stale the slots not refreshed for more than MAX_SLOT_AGE frames, so
+    // that their age saturates instead of wrapping around.
+    //
+    // To be called for each table at least every MODULE_TABLES frames
+    //
+    inline void age(const TPPM::FrameStamp &now)
+    {
+        for (uint8_t slot=0; slot<REFRESH_SLOTS; ++slot)
+        {
+            if ((TPPM::FrameStamp)(now - _refresh_stamp[slot]) > MAX_SLOT_AGE)
+            {
+                _stale_slots |= (1 << slot);
+            }
+        }
+    }
+
+#if defined(TPPM_EXTRA_PREDICTOR)
+    // A frame addressed to this sub-module is going to be decoded into its
+    // channels: keep the values it overwrites for the predictor
+    //
+    inline void refreshing(const uint8_t &scan_index, const TPPM::FrameStamp &now)
+    {
+        uint8_t slot = EXTRA_SCAN_SLOT(scan_index);
+
+        for (uint8_t c=slot; c<EXTRA_CHANNELS_COUNT; c+=EXTRA_SCAN_SLOTS)
+        {
+            TPPM::set_channel(_previous_channels, c, TPPM::get_channel(_extra_channels, c));
+        }
+
+        _previous_stamp[slot] = _extra_stamp[slot];
+        _extra_stamp   [slot] = now;
+        _predictable         |= (_extra_slots & (1 << slot));
+        _extra_slots         |= (1 << slot);
+    }
+
+    // Returns the extra channel value predicted at the given frame from its
+    // last two refreshed values
+    //
+    inline uint16_t predicted_extra_channel(const uint8_t &channel, const TPPM::FrameStamp &now)
+    {
+        return predict(channel, weight(EXTRA_SCAN_SLOT(channel), now));
+    }
+
+    // Write the first count extra channels values predicted at the given
+    // frame: a divide per scan slot and a multiply per channel, short enough
+    // for the readers to run with the interrupts disabled
+    //
+    inline void predicted_extra_channels(uint16_t *channels_out, const uint8_t &count, const TPPM::FrameStamp &now)
+    {
+        int16_t weights[EXTRA_SCAN_SLOTS];
+
+        for (uint8_t s=0; s<EXTRA_SCAN_SLOTS; ++s)
+        {
+            weights[s] = weight(s, now);
+        }
+
+        for (uint8_t c=0; c<count; ++c)
+        {
+            channels_out[c] = predict(c, weights[EXTRA_SCAN_SLOT(c)]);
+        }
+    }
+#endif
+
+    // Returns the frames elapsed since the extra channel was refreshed,
+    // NEVER_REFRESHED if it was not
+    //
+    inline TPPM::FrameStamp extra_channel_age(const uint8_t &channel, const TPPM::FrameStamp &now)
+    {
+        uint8_t slot = EXTRA_REFRESH_SLOT(channel);
+
+        if (_scan_slots & (1 << slot))
+        {
+            return slot_age(slot, now);
+        }
+
+        return NEVER_REFRESHED;
+    }
+
+    // Returns the frames elapsed since the scan index refreshing an on/off
+    // channel (see TPPMTag::onoff_scan_slot()) was received, NEVER_REFRESHED
+    // if it was not
+    //
+    inline TPPM::FrameStamp scan_slot_age(const uint8_t &slot, const TPPM::FrameStamp &now)
+    {
+        if (_scan_slots & (1 << slot))
+        {
+            return slot_age(slot, now);
+        }
+
+        return NEVER_REFRESHED;
+    }
+
+    // Returns true once every channel has been refreshed at least once
+    //
+    inline bool scan_complete()
+    {
+        return ALL_SCAN_SLOTS == _scan_slots;
+    }
+
+    // Returns the length in frames of the last full multiplex cycle,
+    // 0 if none completed yet
+    //
+    inline TPPM::FrameStamp cycle_frames()
+    {
+        return _cycle_frames;
+    }
+
+    // Incremented (and wrapping around) on each frame decoded into the channels
+    //
+    inline uint8_t generation()
+    {
+        return _generation;
+    }
+
+    inline TPPM::ChannelWord *extra_channels()
+    {
+        return _extra_channels;
+    }
+
+    inline uint8_t *onoff_channels()
+    {
+        return _onoff_channels;
+    }
+
+    inline uint16_t extra_channel(const uint8_t &channel)
+    {
+        return TPPM::get_channel(_extra_channels, channel);
+    }
+
+private:
+    TPPM::ChannelWord   _extra_channels[CHANNEL_WORDS(EXTRA_CHANNELS_COUNT)];
+    TPPM::OnOffChannels _onoff_channels;
+    uint8_t             _generation;
+    uint16_t            _scan_slots ;                   // slots ever refreshed
+    uint16_t            _cycle_slots;                   // slots refreshed in the current cycle
+    uint16_t            _stale_slots;                   // slots older than MAX_SLOT_AGE
+    TPPM::FrameStamp    _cycle_start ;
+    TPPM::FrameStamp    _cycle_frames;
+    TPPM::FrameStamp    _refresh_stamp[REFRESH_SLOTS];
+
+#if defined(TPPM_EXTRA_PREDICTOR)
+    TPPM::ChannelWord   _previous_channels[CHANNEL_WORDS(EXTRA_CHANNELS_COUNT)];
+    TPPM::FrameStamp    _extra_stamp      [EXTRA_SCAN_SLOTS];
+    TPPM::FrameStamp    _previous_stamp   [EXTRA_SCAN_SLOTS];
+    uint8_t             _extra_slots;                   // slots refreshed once
+    uint8_t             _predictable;                   // slots refreshed twice
+#endif
+
+    inline TPPM::FrameStamp slot_age(const uint8_t &slot, const TPPM::FrameStamp &now)
+    {
+        TPPM::FrameStamp age = now - _refresh_stamp[slot];
+
+        if ((_stale_slots & (1 << slot)) || (age > MAX_SLOT_AGE))
+        {
+            return MAX_SLOT_AGE;
+        }
+
+        return age;
+    }
+
+#if defined(TPPM_EXTRA_PREDICTOR)
+    // Returns the weight of the last refresh step of the scan slot's channels
+    // at the given frame, PREDICT_ONE being a whole step, 0 if not predicted
+    //
+    inline int16_t weight(const uint8_t &slot, const TPPM::FrameStamp &now)
+    {
+        if (0 == (_predictable & (1 << slot)))
+        {
+            // Not refreshed twice yet
+            //
+            return 0;
+        }
+
+        uint16_t period  = (TPPM::FrameStamp)(_extra_stamp[slot] - _previous_stamp[slot]);
+        uint16_t elapsed = (TPPM::FrameStamp)(now - _extra_stamp[slot]);
+
+        if (0 == period)
+        {
+            return 0;
+        }
+
+        // Never predict farther than the next refresh is due
+        //
+        if (elapsed > period)
+        {
+            elapsed = period;
+        }
+
+        // The refresh periods are a few frames: longer ones are scaled down to
+        // keep the divide 16 bits wide
+        //
+        while (period > 0xff)
+        {
+            period  >>= 1;
+            elapsed >>= 1;
+        }
+
+        int16_t progress = ((elapsed << PREDICT_FRACTION_BITS) + (period >> 1)) / (uint8_t)period;
+
+#if TPPM_EXTRA_PREDICTOR == PREDICT_INTERPOLATE
+        return progress - PREDICT_ONE;
+#else
+        return progress;
+#endif
+    }
+
+    // Returns the extra channel value moved by the weight of its last refresh
+    // step
+    //
+    inline uint16_t predict(const uint8_t &channel, const int16_t &weight)
+    {
+        uint16_t value = TPPM::get_channel(_extra_channels, channel);
+
+        if (0 == weight)
+        {
+            return value;
+        }
+
+        int16_t delta     = (int16_t)(value - TPPM::get_channel(_previous_channels, channel));
+        int16_t predicted = (int16_t)value + (int16_t)(((int32_t)delta * weight) >> PREDICT_FRACTION_BITS);
+
+        if (predicted < (int16_t)MIN_CHANNEL_WIDTH)
+        {
+            return MIN_CHANNEL_WIDTH;
+        }
+
+        if (predicted > (int16_t)MAX_CHANNEL_WIDTH)
+        {
+            return MAX_CHANNEL_WIDTH;
+        }
+
+        return predicted;
+    }
+#endif
+};
+
+#endif // __TPPM_MODULE_H__
@@ -0,0 +1,543 @@
+#if !defined(__TPPM_RECORDER_H__)
+#define __TPPM_RECORDER_H__
+
+#include <avr/eeprom.h>
+
+#include "TPPMSum.h"
+#include "TPPMLock.h"
+
+// EEPROM area used by the flight recorder ring, all the EEPROM before the
+// lock record by default
+//
+#if !defined(RECORDER_EEPROM_START)
+#define RECORDER_EEPROM_START   0
+#endif
+
+#if !defined(RECORDER_EEPROM_SIZE)
+#define RECORDER_EEPROM_SIZE    ( LOCK_EEPROM_START - RECORDER_EEPROM_START )
+#endif
+
+// Channel changes up to this width are not recorded: the sticks noise would
+// wear the EEPROM out for nothing
+//
+#define RECORDER_DEADBAND       USEC_TO_WIDTH( 4 )
+
+// The channel changes are recorded at most once every this many frames, the
+// status changes at once: the last frame before a status change is recorded
+// too, so the channels values the failure found are never lost
+//
+#if !defined(RECORDER_INTERVAL)
+#define RECORDER_INTERVAL       8
+#endif
+
+// A key frame (absolute channels values) every this many bytes: the most of
+// the ring lost when its oldest record has been partially overwritten
+//
+#define RECORDER_KEYFRAME_BYTES 64
+
+// RAM queue of the records waiting to be written
+//
+#define RECORDER_QUEUE_SIZE     32
+
+// Records layout, a header byte:
+//
+//   +------+-----------+---------------+-----------+
+//   | bit  |     7     |       6       |  5 ... 2  |  1 0
+//   +------+-----------+---------------+-----------+-------
+//   |      | good      | fail safe     | channels  | frames
+//   |      | frame     | mode          | changed   | gap
+//   +------+-----------+---------------+-----------+-------
+//
+// followed by the frames gap (frames since the previous record):
+//
+//   RECORD_GAP_1  : none, the frame after the previous record's one
+//   RECORD_GAP_7  : 1 byte , 7 bits count
+//   RECORD_GAP_14 : 2 bytes, 7 bits each, most significant first
+//
+// then by the changed basic channels, each one either:
+//
+//   0ddddddd          : 7 bits signed delta from its previous value
+//   1vvvvvvv 0vvvvvvv : 14 bits absolute value
+//
+// A key frame has a RECORD_KEYFRAME gap code and no channels changed: a 14
+// bits frames gap (0: the recording restarted) and all the basic channels
+// absolute values follow.
+//
+// The ring's head is marked by a RECORD_END byte, which no other byte can
+// be: the oldest record follows it, the first key frame after it is where the
+// decoding starts.
+//
+#define RECORD_END              0xff
+#define RECORD_GOOD             0x80
+#define RECORD_FAIL_SAFE        0x40
+#define RECORD_CHANNELS_SHIFT   2
+#define RECORD_GAP_MASK         0x03
+#define RECORD_GAP_1            0
+#define RECORD_GAP_7            1
+#define RECORD_GAP_14           2
+#define RECORD_KEYFRAME         3
+#define RECORD_MAX_GAP          0x3fff
+#define RECORD_MAX_SIZE         ( 1 + 2 + ( 2 * BASIC_CHANNELS_COUNT ) )
+
+#define IS_KEYFRAME(header)     ( ( (header) & 0x3f ) == RECORD_KEYFRAME )
+
+#if BASIC_CHANNELS_COUNT != 4
+#error "The flight recorder records 4 basic channels"
+#endif
+
+#if MAX_CHANNEL_WIDTH >= 0x3f80
+#error "The flight recorder absolute values are 14 bits wide, raise TIMER1_PRESCALER"
+#endif
+
+#if RECORDER_EEPROM_SIZE > 0xffff
+#error "RECORDER_EEPROM_SIZE must fit in 16 bits"
+#endif
+
+// Flight recorder of the decoded frames: the basic channels values, the good
+// frames and the fail safe mode, in a ring in the EEPROM.
+//
+// Nothing is done in the ISR: update() polls the decoder from the sketch's
+// loop() and queues a record when something changed, service() writes the
+// queued bytes one at a time, only when the EEPROM is ready, so the loop is
+// never blocked on the EEPROM writes. The ring is written sequentially, so
+// all its bytes wear out at the same pace.
+//
+// To not miss frames, update() shall be called at least once per frame.
+//
+// After a crash, replay() walks the ring from the oldest record.
+//
+class TPPMRecorder
+{
+public:
+    struct Entry
+    {
+        uint16_t frames   ;                        // since the previous entry, 0: restarted
+        bool     good     ;
+        bool     fail_safe;
+        uint16_t channels[BASIC_CHANNELS_COUNT];
+    };
+
+    typedef void (*Visitor)(const Entry &entry, void *context);
+
+    TPPMRecorder()
+        : _head       (0)
+        , _record_left(0)
+        , _queue_head (0)
+        , _queue_count(0)
+        , _last_flags (0)
+        , _last_stamp (0)
+        , _gap        (0)
+        , _since_key  (RECORDER_KEYFRAME_BYTES)
+        , _restarted  (true)
+        , _held       (false)
+    {
+        for (uint8_t c=0; c<BASIC_CHANNELS_COUNT; ++c)
+        {
+            _last[c] = 0;
+            _held_channels[c] = 0;
+        }
+    }
+
+    // Find the ring's head, start a new ring if there is none
+    //
+    inline void begin(TPPMSum &decoder)
+    {
+        uint32_t history;
+
+        if (!find_end(_head))
+        {
+            _head = 0;
+
+            eeprom_update_byte(address(_head), RECORD_END);
+        }
+
+        // The first record is a key frame marking the restart
+        //
+        decoder.frame_status(_last_stamp, history);
+
+        _gap         = 0;
+        _since_key   = RECORDER_KEYFRAME_BYTES;
+        _restarted   = true;
+        _held        = false;
+        _record_left = 0;
+        _queue_count = 0;
+    }
+
+    // Account the new frames of the decoder, queue a record if they changed
+    // anything
+    //
+    inline void update(TPPMSum &decoder)
+    {
+        TPPM::FrameStamp    stamp;
+        uint32_t            history;
+        TPPM::BasicChannels channels;
+
+        decoder.frame_status(stamp, history);
+
+        TPPM::FrameStamp frames = stamp - _last_stamp;
+
+        if (0 == frames)
+        {
+            return;
+        }
+
+        decoder.read(channels, NULL, NULL);
+
+        uint8_t flags = ((history & 0x01) ? RECORD_GOOD : 0) | (decoder.fail_safe() ? RECORD_FAIL_SAFE : 0);
+
+        _last_stamp = stamp;
+
+        if ((flags != _last_flags) && _held)
+        {
+            // The status changes: first the last frame of the previous one,
+            // its channels held back by RECORDER_INTERVAL
+            //
+            record(_last_flags, _held_channels, false);
+        }
+
+        _gap = (_gap + frames > RECORD_MAX_GAP) ? RECORD_MAX_GAP : (_gap + frames);
+
+        record(flags, channels, true);
+    }
+
+    // Write a queued byte if the EEPROM is ready, call it as often as possible
+    //
+    inline void service()
+    {
+        if ((0 == _queue_count) || !eeprom_is_ready())
+        {
+            return;
+        }
+
+        if (0 == _record_left)
+        {
+            // A new record: move the head marker past it first, so the ring
+            // always has one
+            //
+            _record_left = dequeue();
+
+            eeprom_update_byte(address(_head + _record_left), RECORD_END);
+
+            return;
+        }
+
+        eeprom_update_byte(address(_head), dequeue());
+
+        _head = (_head + 1) % RECORDER_EEPROM_SIZE;
+
+        --_record_left;
+    }
+
+    // Returns true if all the records have been written
+    //
+    inline bool idle()
+    {
+        return (0 == _queue_count);
+    }
+
+    // Walk the recorded entries, from the oldest, returns their count
+    //
+    static inline uint16_t replay(Visitor visitor, void *context)
+    {
+        uint16_t end;
+
+        if (!find_end(end))
+        {
+            return 0;
+        }
+
+        uint16_t position = (end + 1) % RECORDER_EEPROM_SIZE;
+        uint16_t count    = 0;
+        Entry    entry;
+
+        // Skip to the first (plausible) key frame
+        //
+        while ((position != end) && !is_keyframe(position, end))
+        {
+            position = (position + 1) % RECORDER_EEPROM_SIZE;
+        }
+
+        while (position != end)
+        {
+            uint8_t header = read(position);
+
+            if (RECORD_END == header)
+            {
+                break;
+            }
+
+            uint8_t changed = (header >> RECORD_CHANNELS_SHIFT) & 0x0f;
+            bool    key     = IS_KEYFRAME(header);
+
+            entry.good      = (header & RECORD_GOOD     ) ? true : false;
+            entry.fail_safe = (header & RECORD_FAIL_SAFE) ? true : false;
+
+            switch (header & RECORD_GAP_MASK)
+            {
+                case RECORD_GAP_1 : entry.frames = 1;                                        break;
+                case RECORD_GAP_7 : entry.frames = read(position);                           break;
+                default           : entry.frames = read(position) << 7; entry.frames |= read(position); break;
+            }
+
+            if (key)
+            {
+                changed = 0x0f;
+            }
+
+            for (uint8_t c=0; c<BASIC_CHANNELS_COUNT; ++c)
+            {
+                if (changed & (1 << c))
+                {
+                    uint8_t byte = read(position);
+
+                    if (!key && (0 == (byte & 0x80)))
+                    {
+                        entry.channels[c] += (int8_t)(byte << 1) >> 1;
+                    }
+                    else
+                    {
+                        entry.channels[c] = ((byte & 0x7f) << 7) | read(position);
+                    }
+                }
+            }
+
+            visitor(entry, context);
+
+            ++count;
+        }
+
+        return count;
+    }
+
+private:
+    uint16_t         _head       ; // ring position of the next byte
+    uint8_t          _record_left; // bytes of the record being written
+    uint8_t          _queue[RECORDER_QUEUE_SIZE];
+    uint8_t          _queue_head ;
+    uint8_t          _queue_count;
+    uint16_t         _last[BASIC_CHANNELS_COUNT];
+    uint8_t          _last_flags ;
+    TPPM::FrameStamp _last_stamp ;
+    uint16_t         _gap        ; // frames since the last record
+    uint8_t          _since_key  ; // bytes since the last key frame
+    bool             _restarted  ; // no records since begin()
+    bool             _held       ; // the last frame changes are not recorded...
+    uint16_t         _held_channels[BASIC_CHANNELS_COUNT]; // ...its channels
+
+    static inline uint8_t *address(const uint16_t &position)
+    {
+        return (uint8_t *)(size_t)(RECORDER_EEPROM_START + (position % RECORDER_EEPROM_SIZE));
+    }
+
+    // Read the byte at the position and move past it
+    //
+    static inline uint8_t read(uint16_t &position)
+    {
+        uint8_t byte = eeprom_read_byte(address(position));
+
+        position = (position + 1) % RECORDER_EEPROM_SIZE;
+
+        return byte;
+    }
+
+    static inline bool find_end(uint16_t &end)
+    {
+        for (end=0; end<RECORDER_EEPROM_SIZE; ++end)
+        {
+            if (RECORD_END == eeprom_read_byte(address(end)))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // A key frame header followed by bytes in range
+    //
+    static inline bool is_keyframe(uint16_t position, const uint16_t &end)
+    {
+        if (!IS_KEYFRAME(read(position)))
+        {
+            return false;
+        }
+
+        for (uint8_t b=0; b<(RECORD_MAX_SIZE - 1); ++b)
+        {
+            if (position == end)
+            {
+                return false;
+            }
+
+            uint8_t byte = read(position);
+
+            // gap: two 7 bits bytes, values: 1vvvvvvv 0vvvvvvv
+            //
+            if ((b < 2) ? (byte & 0x80) : (((b & 1) == 0) != ((byte & 0x80) != 0)))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Queue a record of the frame _gap frames after the previous record, if it
+    // changed anything: at most one every RECORDER_INTERVAL frames if only
+    // its channels did and the rate is limited
+    //
+    inline void record(const uint8_t &flags, const uint16_t *channels, const bool &limited)
+    {
+        bool    key     = (_since_key >= RECORDER_KEYFRAME_BYTES);
+        uint8_t changed = 0;
+
+        for (uint8_t c=0; c<BASIC_CHANNELS_COUNT; ++c)
+        {
+            uint16_t delta = (channels[c] > _last[c]) ? (channels[c] - _last[c]) : (_last[c] - channels[c]);
+
+            if (delta > RECORDER_DEADBAND)
+            {
+                changed |= (1 << c);
+            }
+        }
+
+        if (!key && (flags == _last_flags) && (_gap < RECORD_MAX_GAP))
+        {
+            if (0 == changed)
+            {
+                // Nothing worth a record
+                //
+                _held = false;
+
+                return;
+            }
+
+            if (limited && (_gap < RECORDER_INTERVAL))
+            {
+                hold(channels);
+
+                return;
+            }
+        }
+
+        uint8_t record[RECORD_MAX_SIZE];
+        uint8_t size = 1;
+
+        if (key)
+        {
+            record[0]      = flags | RECORD_KEYFRAME;
+            record[size++] = _restarted ? 0 : (_gap >> 7);
+            record[size++] = _restarted ? 0 : (_gap & 0x7f);
+            changed        = 0x0f;
+        }
+        else
+        {
+            record[0] = flags | (changed << RECORD_CHANNELS_SHIFT);
+
+            if (1 == _gap)
+            {
+                record[0] |= RECORD_GAP_1;
+            }
+            else
+            if (_gap < 0x80)
+            {
+                record[0]     |= RECORD_GAP_7;
+                record[size++] = _gap;
+            }
+            else
+            {
+                record[0]     |= RECORD_GAP_14;
+                record[size++] = _gap >> 7;
+                record[size++] = _gap & 0x7f;
+            }
+        }
+
+        for (uint8_t c=0; c<BASIC_CHANNELS_COUNT; ++c)
+        {
+            if (changed & (1 << c))
+            {
+                int16_t delta = (int16_t)(channels[c] - _last[c]);
+
+                if (!key && (delta >= -64) && (delta < 64))
+                {
+                    record[size++] = delta & 0x7f;
+                }
+                else
+                {
+                    record[size++] = 0x80 | (channels[c] >> 7);
+                    record[size++] = channels[c] & 0x7f;
+                }
+            }
+        }
+
+        if (!enqueue(record, size))
+        {
+            // The EEPROM is not keeping up: the frames will be in the next record
+            //
+            hold(channels);
+
+            return;
+        }
+
+        for (uint8_t c=0; c<BASIC_CHANNELS_COUNT; ++c)
+        {
+            if (changed & (1 << c))
+            {
+                _last[c] = channels[c];
+            }
+        }
+
+        _last_flags = flags;
+        _restarted  = false;
+        _held       = false;
+        _gap        = 0;
+        _since_key  = key ? size : (_since_key + size);
+    }
+
+    inline void hold(const uint16_t *channels)
+    {
+        for (uint8_t c=0; c<BASIC_CHANNELS_COUNT; ++c)
+        {
+            _held_channels[c] = channels[c];
+        }
+
+        _held = true;
+    }
+
+    inline bool enqueue(const uint8_t *record, const uint8_t &size)
+    {
+        if ((_queue_count + size + 1) > RECORDER_QUEUE_SIZE)
+        {
+            return false;
+        }
+
+        push(size);
+
+        for (uint8_t b=0; b<size; ++b)
+        {
+            push(record[b]);
+        }
+
+        return true;
+    }
+
+    inline void push(const uint8_t &byte)
+    {
+        _queue[(_queue_head + _queue_count) % RECORDER_QUEUE_SIZE] = byte;
+
+        ++_queue_count;
+    }
+
+    inline uint8_t dequeue()
+    {
+        uint8_t byte = _queue[_queue_head];
+
+        _queue_head = (_queue_head + 1) % RECORDER_QUEUE_SIZE;
+
+        --_queue_count;
+
+        return byte;
+    }
+};
+
+#endif // __TPPM_RECORDER_H__
@@ -1,15 +1,71 @@
 #include <Arduino.h>
 #include <avr/io.h>
 
-#include "TPPSum.h"
+#include "TPPMSum.h"
 
 // Input capture pin 1
 //
 #define ICP1            8
 
+// Input capture pin 1 level (Arduino pin D8 is PB0)
+//
+#define PIN_LEVEL       ((PINB >> PINB0) & 0x01)
+
+// Pin change interrupt pin 1, the second decoder's input (see TPPM::PCINT1_INPUT)
+//
+#define PCI1            9
+
+// Pin change interrupt pin 1 level (Arduino pin D9 is PB1)
+//
+#define PCI1_LEVEL      ((PINB >> PINB1) & 0x01)
+
+#if defined(TPPM_ISR_PROBE)
+// Interrupts run time probe pin (Arduino pin D13 is PB5)
+//
+#define PROBE_PIN       13
+
+#define PROBE_ON()      (PORTB |=  (1 << PORTB5))
+#define PROBE_OFF()     (PORTB &= ~(1 << PORTB5))
+#else
+#define PROBE_ON()
+#define PROBE_OFF()
+#endif
+
+// Timer1 value latched by the input capture unit
+//
+#define TIMER           ICR1
+
 // Timer is just running normal free-run mode. The top will be defined as 2^16 -1
 //
-#define MAX_TIMER_VALUE 0xffff
+// Half of its range, used to tell whether a pending overflow precedes a capture
+//
+#define HALF_TIMER_VALUE 0x8000
+
+// Clock select bits for the configured TIMER1_PRESCALER
+//
+#if   TIMER1_PRESCALER == 1
+#define TIMER1_CLOCK_SELECT ((1 << CS10) | (0 << CS11) | (0 << CS12))
+#elif TIMER1_PRESCALER == 8
+#define TIMER1_CLOCK_SELECT ((0 << CS10) | (1 << CS11) | (0 << CS12))
+#elif TIMER1_PRESCALER == 64
+#define TIMER1_CLOCK_SELECT ((1 << CS10) | (1 << CS11) | (0 << CS12))
+#elif TIMER1_PRESCALER == 256
+#define TIMER1_CLOCK_SELECT ((0 << CS10) | (0 << CS11) | (1 << CS12))
+#else
+#error "TIMER1_PRESCALER must be one of 1, 8, 64 or 256"
+#endif
+
+// Timer1 overflows count: the high word of the 32 bits capture timebase
+//
+static volatile uint16_t timer1_overflows = 0;
+
+// The decoder instance served by the input capture interrupt
+//
+static TPPMSum *ppmsum = NULL;
+
+// The decoder instance served by the pin change interrupt
+//
+static TPPMSum *pcisum = NULL;
 
 /**
  * Initialize the user provided output buffers
@@ -18,12 +74,13 @@
  *
  * Enable the input capture interrupt.
  */
-void TPPMSum::init(const uint8_t decoder_id        ,
-                   BasicChannels basic_channels_out,
-                   ExtraChannels extra_channels_out,
-                   OnOffChannels onoff_channels_out,
-                   uint16_t      default_servo_value,
-                   bool          default_onoff_value)
+void TPPMSum::init(const uint16_t      decoder_id         ,
+                   TPPM::BasicChannels basic_channels_out ,
+                   TPPM::ExtraChannels extra_channels_out ,
+                   TPPM::OnOffChannels onoff_channels_out ,
+                   uint16_t            default_servo_value,
+                   bool                default_onoff_value,
+                   const TPPM::Input   input              )
 {
     // Set the receiver ID (my own id) for further comparisons
     //
@@ -59,17 +116,24 @@ void TPPMSum::init(const uint8_t decoder_id        ,
         }
     }
 
-    // Define inputs: (interrupt pins)
+    // Initialize the sub-modules channels tables
     //
-    pinMode(ICP1, INPUT); // Input capture, pin D8
+    for (uint8_t m=0; m<MODULE_TABLES; ++m)
+    {
+        _modules[m].reset(default_servo_value, default_onoff_value);
+    }
 
-    // Set internal pull-down resistor. Can be convenient in some cases.
-    // Used here to allow one port to be unconnected
-    // You can use pull-up as well.
+    // Nothing left to decode into them
     //
-    digitalWrite(ICP1, HIGH);
+    _commit = COMMIT_NONE;
+
+#if defined(TPPM_ISR_PROBE)
+    pinMode(PROBE_PIN, OUTPUT);
+
+    PROBE_OFF();
+#endif
 
-    // Init all the timer-settings.
+    // Init all the timer-settings, unless the other decoder already runs them.
     // We will use timer1, as it has 16 bit resolution and some nice features.
 
     // Input capture is connected to ICP1 (Arduino pin D8)
@@ -81,60 +145,171 @@ void TPPMSum::init(const uint8_t decoder_id        ,
 
     // Will go throguh all register settings in timer1. Only very little have to be changed when using input capture.
 
-    // First register. We don't really need to set anything here.
-    // page 132
-    //
-    TCCR1A = (0 << WGM10 ) | // Waveform generation - normal count
-             (0 << WGM11 ) | // Waveform generation - normal count
-             (0 << COM1A1) | // compare output, not needed
-             (0 << COM1A0) | // compare output, not needed
-             (0 << COM1B1) | // compare output, not needed
-             (0 << COM1B0) ; // compare output, not needed
-
-    // TCCR1B, used to set prescaler for timer and the input-capture settings:
-    //
-    TCCR1B = (1 << ICNC1) | // Input capture noise canceler - set to active
-             (1 << ICES1) | // Input capture edge select. 1 = rising, 0 = falling.
-                            // We will toggle this, doesn't matter what it starts at
-             (0 << CS10 ) | // Prescale 8
-             (1 << CS11 ) | // Prescale 8
-             (0 << CS12 ) | // Prescale 8
-             (0 << WGM13) | // Just normal counter
-             (0 << WGM12) ; // Just normal counter
-
-    // Not used in this case:
-    //
-    TCCR1C = (0 << FOC1A) | // No force output compare (A)
-             (0 << FOC1B) ; // No force output compare (B)
+    if (0 == (TIMSK1 & (1 << TOIE1)))
+    {
+        // First register. We don't really need to set anything here.
+        // page 132
+        //
+        TCCR1A = (0 << WGM10 ) | // Waveform generation - normal count
+                 (0 << WGM11 ) | // Waveform generation - normal count
+                 (0 << COM1A1) | // compare output, not needed
+                 (0 << COM1A0) | // compare output, not needed
+                 (0 << COM1B1) | // compare output, not needed
+                 (0 << COM1B0) ; // compare output, not needed
+
+        // TCCR1B, used to set prescaler for timer and the input-capture settings:
+        //
+        TCCR1B = (1 << ICNC1)        | // Input capture noise canceler - set to active
+                 (!PIN_LEVEL << ICES1) | // Input capture edge select. 1 = rising, 0 = falling.
+                                       // The edge leaving the line level, then selected
+                                       // by the capture interrupt at every edge
+                 TIMER1_CLOCK_SELECT | // Prescale TIMER1_PRESCALER
+                 (0 << WGM13)        | // Just normal counter
+                 (0 << WGM12)        ; // Just normal counter
+
+        // Not used in this case:
+        //
+        TCCR1C = (0 << FOC1A) | // No force output compare (A)
+                 (0 << FOC1B) ; // No force output compare (B)
 
-    // Enable the interrupts. We only use input capture.
-    //
-    TIMSK1 = (1 << ICIE1 ) | // Enable input capture interrupt
-             (0 << OCIE1B) | // Disable output compare B
-             (0 << OCIE1A) | // Disable output compare A
-             (0 << TOIE1 ) ; // Disable overflow interrupt
+        // Enable the overflows interrupt, extending the capture timebase to
+        // 32 bits for both the decoders.
+        //
+        TIMSK1 = (0 << ICIE1 ) | // Input capture interrupt, enabled below
+                 (0 << OCIE1B) | // Disable output compare B
+                 (0 << OCIE1A) | // Disable output compare A
+                 (1 << TOIE1 ) ; // Enable overflow interrupt
+    }
+
+    if (TPPM::PCINT1_INPUT == input)
+    {
+        // Attach this decoder to the pin change interrupt, its edges are
+        // timestamped from Timer1 when the interrupt runs: the input capture
+        // settings belong to the other decoder
+        //
+        pcisum = this;
+
+        pinMode(PCI1, INPUT);
+
+        digitalWrite(PCI1, HIGH);
+
+        PCMSK0 |= (1 << PCINT1); // Pin change of D9 only
+        PCICR  |= (1 << PCIE0 ); // Enable the pin change interrupt of port B
+    }
+    else
+    {
+        // Attach this decoder to the input capture interrupt
+        //
+        ppmsum = this;
+
+        // Define inputs: (interrupt pins)
+        //
+        pinMode(ICP1, INPUT); // Input capture, pin D8
+
+        // Set internal pull-down resistor. Can be convenient in some cases.
+        // Used here to allow one port to be unconnected
+        // You can use pull-up as well.
+        //
+        digitalWrite(ICP1, HIGH);
+
+        // Capture the edge leaving the line level, with the noise canceler
+        //
+        TCCR1B = (TCCR1B & ~(1 << ICES1)) | (1 << ICNC1) | (!PIN_LEVEL << ICES1);
+
+        bitSet(TIMSK1, ICIE1); // Enable input capture interrupt
+    }
 }
 
-// Disable the input capture interrupt.
+// Disable the input capture interrupt, or the pin change one of the second
+// decoder, then the overflows one when no decoder is left running.
 //
 void TPPMSum::stop(void)
 {
-    bitClear(TIMSK1, ICIE1);
+    if (this == pcisum)
+    {
+        bitClear(PCMSK0, PCINT1);
+
+        pcisum = NULL;
+    }
+    else if (this == ppmsum)
+    {
+        bitClear(TIMSK1, ICIE1);
+
+        ppmsum = NULL;
+    }
+
+    if ((NULL == ppmsum) && (NULL == pcisum))
+    {
+        bitClear(TIMSK1, TOIE1);
+    }
+}
+
+// Extend a Timer1 value to 32 bits with the overflows count.
+//
+// Must be called with the interrupts disabled.
+//
+static inline uint32_t extend_timer(uint16_t timer)
+{
+    uint16_t overflows = timer1_overflows;
+
+    // An overflow still pending while the timer is in its lower half happened
+    // before the timer was latched, but has not yet been counted
+    //
+    if ((TIFR1 & (1 << TOV1)) && (timer < HALF_TIMER_VALUE))
+    {
+        ++overflows;
+    }
+
+    return ((uint32_t)overflows << 16) | timer;
+}
+
+// Atomically read the 32 bits capture timebase
+//
+uint32_t TPPMSum::capture_clock(void)
+{
+    uint8_t sreg = SREG;
+
+    noInterrupts();
+
+    uint32_t now = extend_timer(TCNT1);
+
+    SREG = sreg;
+
+    return now;
+}
+
+// Atomically check the watchdog, the last good frame time is written by the ISR
+//
+bool TPPMSum::timeout(void)
+{
+    uint8_t sreg = SREG;
+
+    noInterrupts();
+
+    bool timed_out = watchdog(extend_timer(TCNT1));
+
+    SREG = sreg;
+
+    return timed_out;
 }
 
 // Atomically read the current PPM channels values into the buffers provided by the user
 //
-uint8_t TPPMSum::read(BasicChannels basic_channels_out,
-                      ExtraChannels extra_channels_out,
-                      OnOffChannels onoff_channels_out);
+uint8_t TPPMSum::read(TPPM::BasicChannels basic_channels_out,
+                      TPPM::ExtraChannels extra_channels_out,
+                      TPPM::OnOffChannels onoff_channels_out)
 {
     noInterrupts();
 
+    commit(COMMIT_MODULE);
+
     uint8_t retval = (_flags.entangled) ? _tag.part_index() : 0;
 
+    TPPMModule &module = _modules[MODULE_TABLE(retval)];
+
     uint8_t buffer = _flags.frame_buffer;
 
-    uint8_t num_onoff_channles = (_flags.entangled) ? ONOFF_CHANNELS_BYTES : 0;
+    uint8_t num_onoff_channles = (_flags.entangled) ? (_tag.onoff_channels_count() >> 3) : 0;
 
     uint8_t num_extra_channels = extra_channels_count();
 
@@ -142,33 +317,42 @@ uint8_t TPPMSum::read(BasicChannels basic_channels_out,
                                      max(num_extra_channels,
                                          num_onoff_channles));
 
-    if (_flags.fail_safe_mode || (timeout() && _flags.fail_safe_set))
+    if (fail_safe())
     {
         buffer = FAIL_SAFE_BUFFER;
     }
 
+#if defined(TPPM_EXTRA_PREDICTOR)
+    if ((NULL != extra_channels_out) && _flags.entangled)
+    {
+        module.predicted_extra_channels(extra_channels_out, num_extra_channels, _frame_stamp);
+    }
+#endif
+
     for (uint8_t i=0; i<num_total_channels; ++i)
     {
         if ((NULL != basic_channels_out) && (i < BASIC_CHANNELS_COUNT))
         {
-            basic_channels_out[i] = _raw_channels[buffer][i];
+            basic_channels_out[i] = raw_channel(buffer, i);
         }
 
         if ((NULL != extra_channels_out) && (i < num_extra_channels))
         {
-            if (_flags.entangled)
+            if (!_flags.entangled)
             {
-                extra_channels_out[i] = _extra_channels[i];
+                extra_channels_out[i] = raw_channel(buffer, i+BASIC_CHANNELS_COUNT);
             }
+#if !defined(TPPM_EXTRA_PREDICTOR)
             else
             {
-                extra_channels_out[i] = _raw_channels[buffer][i+BASIC_CHANNELS_COUNT];
+                extra_channels_out[i] = module.extra_channel(i);
             }
+#endif
         }
 
         if ((NULL != onoff_channels_out) && (i < num_onoff_channles))
         {
-            onoff_channels_out[i] = _onoff_channels[i];
+            onoff_channels_out[i] = module.onoff_channels()[i];
         }
     }
 
@@ -177,37 +361,358 @@ uint8_t TPPMSum::read(BasicChannels basic_channels_out,
     return retval;
 }
 
+// Atomically read the extra and on/off channels of a sub-module into the buffers
+// provided by the user
+//
+uint8_t TPPMSum::read_module(const uint8_t       module            ,
+                             TPPM::ExtraChannels extra_channels_out,
+                             TPPM::OnOffChannels onoff_channels_out)
+{
+    TPPMModule &table = _modules[MODULE_TABLE(module)];
+
+    noInterrupts();
+
+    commit(module_stages(module));
+
+    if (NULL != extra_channels_out)
+    {
+#if defined(TPPM_EXTRA_PREDICTOR)
+        table.predicted_extra_channels(extra_channels_out, EXTRA_CHANNELS_COUNT, _frame_stamp);
+#else
+        for (uint8_t c=0; c<EXTRA_CHANNELS_COUNT; ++c)
+        {
+            extra_channels_out[c] = table.extra_channel(c);
+        }
+#endif
+    }
+
+    if (NULL != onoff_channels_out)
+    {
+        for (uint8_t c=0; c<ONOFF_CHANNELS_BYTES; ++c)
+        {
+            onoff_channels_out[c] = table.onoff_channels()[c];
+        }
+    }
+
+    uint8_t generation = table.generation();
+
+    interrupts();
+
+    return generation;
+}
+
+// Atomically read the age of a sub-module's channels
+//
+TPPM::FrameStamp TPPMSum::extra_channel_age(const uint8_t module, const uint8_t channel)
+{
+    noInterrupts();
+
+    commit(age_stages(module));
+
+    TPPM::FrameStamp age = _modules[MODULE_TABLE(module)].extra_channel_age(channel, _frame_stamp);
+
+    interrupts();
+
+    return age;
+}
+
+TPPM::FrameStamp TPPMSum::onoff_channel_age(const uint8_t module, const uint8_t channel)
+{
+    noInterrupts();
+
+    commit(age_stages(module));
+
+    TPPM::FrameStamp age = _modules[MODULE_TABLE(module)].scan_slot_age(_tag.onoff_scan_slot(channel), _frame_stamp);
+
+    interrupts();
+
+    return age;
+}
+
+TPPM::FrameStamp TPPMSum::scan_cycle_frames(const uint8_t module)
+{
+    noInterrupts();
+
+    commit(module_stages(module));
+
+    TPPM::FrameStamp frames = _modules[MODULE_TABLE(module)].cycle_frames();
+
+    interrupts();
+
+    return frames;
+}
+
+// Atomically read the link quality indicators
+//
+void TPPMSum::link_quality(TPPM::LinkQuality &quality)
+{
+    noInterrupts();
+
+    commit(COMMIT_LINK);
+
+    TPPMLink link     = _link;
+    bool     no_link  = timeout();
+
+    interrupts();
+
+    link.get(quality);
+
+    if (no_link)
+    {
+        // No frames at all: the indicators are stale
+        //
+        quality.frames_per_second = 0;
+        quality.good_frames_ratio = 0;
+        quality.score             = 0;
+    }
+}
+
+// Atomically read the frames counter and the good frames history
+//
+void TPPMSum::frame_status(TPPM::FrameStamp &frame_stamp, uint32_t &good_frames)
+{
+    noInterrupts();
+
+    commit(COMMIT_LINK);
+
+    frame_stamp = _frame_stamp;
+    good_frames = _link.history();
+
+    interrupts();
+}
+
+// Atomically read the lock on the current transmitter
+//
+bool TPPMSum::lock_state(TPPM::Lock &lock)
+{
+    noInterrupts();
+
+    bool locked = !initializing() && _flags.fail_safe_set;
+
+    if (locked)
+    {
+        lock.fingerprint = _fingerprint;
+        lock.pulse_level = _flags.pulse_level;
+        lock.coupled_id  = _tag.coupled_id();
+
+        for (uint8_t w=0; w < CHANNEL_WORDS(MAX_CHANNELS); w++)
+        {
+            lock.fail_safe[w] = _raw_channels[FAIL_SAFE_BUFFER][w];
+        }
+    }
+
+    interrupts();
+
+    return locked;
+}
+
+// Atomically restore the lock of a previous run
+//
+void TPPMSum::warm_start(const TPPM::Lock &lock)
+{
+    noInterrupts();
+
+    _fingerprint = lock.fingerprint;
+
+    _tag.couple(lock.coupled_id);
+
+    for (uint8_t w=0; w < CHANNEL_WORDS(MAX_CHANNELS); w++)
+    {
+        _raw_channels[FAIL_SAFE_BUFFER][w] = lock.fail_safe[w];
+    }
+
+    // Output the fail safe frame until locked
+    //
+    _flags.fail_safe_set  = 1;
+    _flags.fail_safe_mode = 1;
+    _flags.warm_start     = 1;
+    _flags.warm_level     = lock.pulse_level & HI_LEVEL;
+
+    interrupts();
+}
+
+#if TRANSMITTERS > 1
+// Atomically enter a transmitter in the table of the known ones
+//
+bool TPPMSum::add_transmitter(const uint8_t encoder_id, const uint8_t priority)
+{
+    if (0 == encoder_id)
+    {
+        return false;
+    }
+
+    noInterrupts();
+
+    uint8_t transmitter = find_transmitter(encoder_id);
+
+    for (uint8_t t=0; (NO_TRANSMITTER == transmitter) && (t < TRANSMITTERS); ++t)
+    {
+        if (0 == _transmitters[t].encoder_id())
+        {
+            transmitter = t;
+        }
+    }
+
+    if (NO_TRANSMITTER != transmitter)
+    {
+        _transmitters[transmitter].add(encoder_id, priority);
+    }
+
+    interrupts();
+
+    return (NO_TRANSMITTER != transmitter);
+}
+
+// Atomically change the selection of the transmitter driving the outputs
+//
+void TPPMSum::select_transmitters(const TPPM::Selection selection, const uint8_t encoder_id)
+{
+    noInterrupts();
+
+    _selection = selection;
+    _selected  = encoder_id;
+
+    interrupts();
+}
+
+// Atomically read the basic channels of a known transmitter's last frame
+//
+bool TPPMSum::read_transmitter(const uint8_t encoder_id, TPPM::BasicChannels basic_channels_out)
+{
+    noInterrupts();
+
+    uint8_t transmitter = find_transmitter(encoder_id);
+    bool    alive       = (NO_TRANSMITTER != transmitter) && _transmitters[transmitter].alive(_frame_stamp);
+
+    if (alive && (NULL != basic_channels_out))
+    {
+        for (uint8_t c=0; c<BASIC_CHANNELS_COUNT; ++c)
+        {
+            // The one driving the outputs keeps its channels in the frame buffer
+            //
+            basic_channels_out[c] = (transmitter == _active)
+                                    ? raw_channel(_flags.frame_buffer, c)
+                                    : TPPM::get_channel(_transmitters[transmitter].channels(), c);
+        }
+    }
+
+    interrupts();
+
+    return alive;
+}
+#endif
+
+// Select the input capture edge leaving the line level: the falling one if
+// it is high. The capture flag must be cleared after a change of the edge.
+//
+static inline void select_edge(const uint8_t &level)
+{
+    if (level)
+    {
+        TCCR1B &= ~(1 << ICES1);
+    }
+    else
+    {
+        TCCR1B |= (1 << ICES1);
+    }
+
+    TIFR1 = (1 << ICF1);
+}
+
 // TIMER1_CAPT_vect is invoked by the AVR timer hardware when a pulse appears on the input pin.
 //
 // On entry, the width of the pulse (as measured by timer1) will have been moved into ICR1.
 //
 // As usual, interrupts are disabled inside the handler.
 //
+// The edge captured is the one selected by ICES1, so is the level it left the
+// line at: a rising edge, a high level. The pin may already be back to the
+// previous level if the interrupt ran late, another edge being missed: the
+// next edge selected is the one leaving the pin level, the decoder then finds
+// two edges in a row with the same level (see TPPMSum::missed_edge()).
+//
 ISR(TIMER1_CAPT_vect)
 {
-    static uint16_t last_capture_time = 0;
+    static uint32_t last_capture_time = 0;
     static uint16_t last_pulse_width  = 0;
 
-    uint8_t  signal_level         = PIN_LEVEL;
-    uint16_t current_capture_time = TIMER;
-    uint16_t signal_width         = current_capture_time;
+    PROBE_ON();
 
-    // Calculate the signal width wrt the timer overflow
+    uint8_t  signal_level         = (TCCR1B >> ICES1) & 0x01;
+    uint32_t current_capture_time = extend_timer(TIMER);
+    uint32_t elapsed_time         = current_capture_time - last_capture_time;
+
+    // Select the next edge, the one leaving the current pin level
+    //
+    select_edge(PIN_LEVEL);
+
+    // Saturate the signal width: anything longer is too long anyway
     //
-    if (last_capture_time > current_capture_time)
+    uint16_t signal_width = (elapsed_time > MAX_SIGNAL_WIDTH) ? MAX_SIGNAL_WIDTH : elapsed_time;
+
+    last_capture_time = current_capture_time;
+
+    // Let's analyse and collect the signal
+    //
+    if (NULL != ppmsum)
     {
-        signal_width += ( MAX_TIMER_VALUE - last_capture_time );
+        last_pulse_width = ppmsum->process(signal_level        ,
+                                           signal_width        ,
+                                           last_pulse_width    ,
+                                           current_capture_time);
     }
-    else
+
+    PROBE_OFF();
+}
+
+// PCINT0_vect is invoked by the AVR pin change hardware when the level of D9
+// changes (see TPPM::PCINT1_INPUT).
+//
+// The edge is timestamped from Timer1 here, not latched by the hardware: the
+// input capture interrupt running at the same time delays it.
+//
+ISR(PCINT0_vect)
+{
+    static uint32_t last_capture_time = 0;
+    static uint16_t last_pulse_width  = 0;
+
+    PROBE_ON();
+
+    uint8_t  signal_level         = PCI1_LEVEL;
+    uint32_t current_capture_time = extend_timer(TCNT1);
+    uint32_t elapsed_time         = current_capture_time - last_capture_time;
+
+    uint16_t signal_width = (elapsed_time > MAX_SIGNAL_WIDTH) ? MAX_SIGNAL_WIDTH : elapsed_time;
+
+    last_capture_time = current_capture_time;
+
+    if (NULL != pcisum)
     {
-        signal_width -= last_capture_time;
+        last_pulse_width = pcisum->process(signal_level        ,
+                                           signal_width        ,
+                                           last_pulse_width    ,
+                                           current_capture_time);
     }
 
-    last_capture_time = current_capture_time;
+    PROBE_OFF();
+}
 
-    // Let's analyse and collect the signal
-    //
-    last_pulse_width = ppmsum.process(signal_level    ,
-                                      signal_width    ,
-                                      last_pulse_width);
+// TIMER1_OVF_vect is invoked by the AVR timer hardware when Timer1 wraps around.
+//
+// It counts the high word of the 32 bits capture timebase, and latches the
+// running decoders watchdog well before the timebase wraps around.
+//
+ISR(TIMER1_OVF_vect)
+{
+    uint32_t now = (uint32_t)(++timer1_overflows) << 16;
+
+    if (NULL != ppmsum)
+    {
+        ppmsum->watchdog(now);
+    }
+
+    if (NULL != pcisum)
+    {
+        pcisum->watchdog(now);
+    }
 }
@@ -2,11 +2,21 @@
 #define __TPPM_SUM_H__
 
 #include "TPPMTag.h"
+#include "TPPMLink.h"
+#include "TPPMFingerprint.h"
+#include "TPPMModule.h"
+#include "TPPMTransmitter.h"
+#include "TPPMClock.h"
 
 // Number of consecutive good frames required at startup.
 //
 #define GOOD_FRAMES_COUNT   10
 
+// Number of consecutive good frames required after a warm start, matching
+// the transmitter's lock of the previous run (see warm_start()).
+//
+#define WARM_FRAMES_COUNT   2
+
 // Number of consecutive bad frames accepted without going to failsafe.
 //
 #define HOLD_FRAMES_COUNT   25
@@ -15,45 +25,86 @@
 //
 #define WATCHDOG_TIMEOUT_MS SEC_TO_MS(10)
 
+// Timer1 ticks without good frames before triggering the watchdog.
+//
+#define WATCHDOG_TIMEOUT    MSEC_TO_WIDTH(WATCHDOG_TIMEOUT_MS)
+
 ISR(TIMER1_CAPT_vect);
+ISR(PCINT0_vect);
+ISR(TIMER1_OVF_vect);
 
-class TPPMSum
+namespace TPPM
 {
-public:
-    TPPMSum(const PPMSum& ref)
+    // The decoder's PPM input: the Timer1 input capture pin (D8), or the pin
+    // change interrupt of D9 timestamped from Timer1 for a second decoder (see
+    // TPPMDiversity)
+    //
+    enum Input
     {
-        *this = ref;
-    }
+        ICP1_INPUT = 0,
+        PCINT1_INPUT
+    };
+
+    // The lock on a transmitter, what the decoder needs to lock on it again
+    // without learning it (see TPPMSum::warm_start())
+    //
+    struct Lock
+    {
+        TPPMFingerprint fingerprint;
+        uint8_t         pulse_level;
+        uint8_t         coupled_id ; // 0: plain PPM transmitter
+        ChannelWord     fail_safe[CHANNEL_WORDS(MAX_CHANNELS)];
+    };
+};
 
+class TPPMSum
+{
+public:
     TPPMSum()
         : _state(INIT_DECODE)
-        , _last_good_frame_time(millis())
+        , _last_good_frame_time(0)
+        , _last_sync_time(0)
+        , _frame_period(0)
+        , _frame_stamp(0)
+        , _locks(0)
+        , _missed_edges(0)
+        , _commit(COMMIT_NONE)
+#if TRANSMITTERS > 1
+        , _active(NO_TRANSMITTER)
+        , _recent(NO_TRANSMITTER)
+        , _selected(0)
+        , _selection(TPPM::SELECT_PRIORITY)
+#endif
     {
         _flags.fail_safe_mode   = 0;
+        _flags.fail_safe_set    = 0;
         _flags.signature_buffer = 0;
         _flags.frame_buffer     = ALT1_DATA_BUFFER;
         _flags.pulse_level_set  = 0;
         _flags.pulse_level      = HI_LEVEL;
         _flags.entangled        = 0;
+        _flags.warm_start       = 0;
+        _flags.warm_level       = HI_LEVEL;
+        _flags.frame_rejected   = 0;
+        _flags.edge_level       = LO_LEVEL;
+        _flags.timed_out        = 0;
         _min_signal_width       = MIN_GAP_WIDTH;
         _max_signal_width       = MAX_GAP_WIDTH;
 
         _tag.reset();
 
-        _dsr[SIGNATURE_REF_DATA][LO_LEVEL].reset();
-        _dsr[SIGNATURE_REF_DATA][HI_LEVEL].reset();
-
-        _dsr[SIGNATURE_CUR_DATA][LO_LEVEL].reset();
-        _dsr[SIGNATURE_CUR_DATA][HI_LEVEL].reset();
+        reset_signatures();
     }
 
     // Initialize the user provided channels arrays and start the PPMSum decoder
     //
-    void init(TPPM::BasicChannels basic_channels     ,
+    void init(const uint16_t      decoder_id         ,
+              TPPM::BasicChannels basic_channels     ,
               TPPM::ExtraChannels extra_channels     ,
               TPPM::OnOffChannels onoff_channels     ,
               uint16_t            default_servo_value,
-              bool                default_onoff_value);
+              bool                default_onoff_value,
+              const TPPM::Input   input = TPPM::ICP1_INPUT);
 
     // Stop the PPMSum decoder
     //
@@ -65,11 +116,82 @@ public:
                  TPPM::ExtraChannels extra_channels,
                  TPPM::OnOffChannels onoff_channels);
 
+    // Returns the current Timer1 time extended to 32 bits by the overflows count,
+    // the timebase of all the capture timestamps
+    //
+    static uint32_t capture_clock(void);
+
+    // Retrieve the extra and on/off channels of the given sub-module and
+    // returns its generation (see module_generation())
+    //
+    uint8_t read_module(const uint8_t       module        ,
+                        TPPM::ExtraChannels extra_channels,
+                        TPPM::OnOffChannels onoff_channels);
+
+    // Returns a counter incremented on each frame decoded into the given
+    // sub-module channels: if it did not change since the last read_module()
+    // the sub-module channels did not change either
+    //
+    inline uint8_t module_generation(const uint8_t &module)
+    {
+        return _modules[MODULE_TABLE(module)].generation();
+    }
+
+    // Returns the frames elapsed since the given sub-module's extra channel was
+    // last refreshed by its scan slot, saturated at MAX_SLOT_AGE,
+    // NEVER_REFRESHED if it was not yet
+    //
+    TPPM::FrameStamp extra_channel_age(const uint8_t module, const uint8_t channel);
+
+    // Returns the frames elapsed since the given sub-module's on/off channel was
+    // last refreshed by its scan slot, saturated at MAX_SLOT_AGE,
+    // NEVER_REFRESHED if it was not yet
+    //
+    TPPM::FrameStamp onoff_channel_age(const uint8_t module, const uint8_t channel);
+
+    // Returns the length in frames of the last full multiplex cycle of the given
+    // sub-module (all its extra and on/off channels refreshed), 0 if none yet
+    //
+    TPPM::FrameStamp scan_cycle_frames(const uint8_t module);
+
+    // Returns true once all the given sub-module's channels have been refreshed
+    //
+    inline bool scan_complete(const uint8_t &module)
+    {
+        return _modules[MODULE_TABLE(module)].scan_complete();
+    }
+
     // Returns true if no good frames received within the WATCHDOG_TIMEOUT_MS
     //
-    inline bool timeout(void)
+    bool timeout(void);
+
+    // Returns the length of the last frame, sync to sync, in Timer1 ticks
+    // (see WIDTH_TO_USEC)
+    //
+    inline uint16_t frame_period(void)
+    {
+        return _frame_period;
+    }
+
+    // Returns the estimated ratio of the transmitter clock to the receiver one,
+    // CLOCK_RATIO_ONE if they are the same or TPPM_CLOCK_REFERENCE_US is not
+    // defined: all the widths are rescaled by it
+    //
+    inline uint16_t clock_ratio(void)
+    {
+#if defined(TPPM_CLOCK_REFERENCE_US)
+        return _clock.ratio();
+#else
+        return CLOCK_RATIO_ONE;
+#endif
+    }
+
+    // Returns true if the fail safe channels values are being read instead of
+    // the last good frame ones
+    //
+    inline bool fail_safe(void)
     {
-        return ((_last_good_frame_time - millis()) >= WATCHDOG_TIMEOUT_MS);
+        return _flags.fail_safe_set && (_flags.fail_safe_mode || timeout());
     }
 
     // Returns true if the decoder is capturing whole frames, either usable or not
@@ -89,8 +211,8 @@ public:
     inline uint8_t total_channels_count(void)
     {
         return max(BASIC_CHANNELS_COUNT,
-                   max(extra_channels(),
-                       onoff_channels()));
+                   max(extra_channels_count(),
+                       onoff_channels_count()));
     }
 
     // Returns the number of basic channels
@@ -118,7 +240,11 @@ public:
             return EXTRA_CHANNELS_COUNT;
         }
 
-        return _dsr[_flags.signature_buffer].captures - BASIC_CHANNELS_COUNT;
+        // The reference frame ones, the current frame is still being captured
+        //
+        uint8_t channels = reference_channels();
+
+        return (channels > BASIC_CHANNELS_COUNT) ? (channels - BASIC_CHANNELS_COUNT) : 0;
     }
 
     // If the frame does not have a digital tag, it returns 0
@@ -126,18 +252,77 @@ public:
     // If the frame has a digital tag, it returns:
     //
     // - the number of the supported ON/OFF switches which are encoded
-    //   in the last 3 channels in the frame
+    //   in the last channels in the frame, as many as the frame layout
+    //   carries (see TPPMTag::detect_layout())
     //
     inline uint8_t onoff_channels_count(void)
     {
         if (_flags.entangled)
         {
-            return ONOFF_CHANNELS_COUNT;
+            return _tag.onoff_channels_count();
         }
 
         return 0;
     }
 
+    // Retrieve the link quality indicators
+    //
+    void link_quality(TPPM::LinkQuality &quality);
+
+    // Returns a counter incremented every time the decoder locks on a
+    // transmitter: if it changed, lock_state() has a new lock to persist
+    //
+    inline uint8_t locks(void)
+    {
+        return _locks;
+    }
+
+    // Returns a counter incremented every time an edge is found missing in a
+    // frame: the capture interrupt ran too late to see it
+    //
+    inline uint8_t missed_edges(void)
+    {
+        return _missed_edges;
+    }
+
+    // Retrieve the lock on the current transmitter, returns false if the
+    // decoder is not locked
+    //
+    bool lock_state(TPPM::Lock &lock);
+
+    // Start from the lock of a previous run (see TPPMLock): its fail safe
+    // frame is output at once, and the transmitter is locked again after
+    // WARM_FRAMES_COUNT matching frames instead of GOOD_FRAMES_COUNT. A
+    // mismatching frame falls back to learning the transmitter.
+    //
+    void warm_start(const TPPM::Lock &lock);
+
+#if TRANSMITTERS > 1
+    // Know the tagged transmitter with the encoder id, the lowest priority
+    // value first (see TPPM::SELECT_PRIORITY), returns false if the table is
+    // full. Its frames for this decoder are tracked while another transmitter
+    // drives the outputs, its fingerprint, fail safe frame and last channels
+    // learned from them: when selected it takes over on its next frame.
+    //
+    bool add_transmitter(const uint8_t encoder_id, const uint8_t priority);
+
+    // Select which known transmitter drives the outputs: with
+    // TPPM::SELECT_EXPLICIT the one with the encoder id only
+    //
+    void select_transmitters(const TPPM::Selection selection, const uint8_t encoder_id = 0);
+
+    // Retrieve the basic channels of the last frame of a known transmitter,
+    // returns false if it is unknown or lost (see TRANSMITTER_LOST_FRAMES)
+    //
+    bool read_transmitter(const uint8_t encoder_id, TPPM::BasicChannels basic_channels);
+#endif
+
+    // Retrieve the frames captured so far (wrapping around) and the good frames
+    // history, one bit per frame, the last frame in bit 0: polled outside of the
+    // ISR, they tell which frames are new and whether they were good
+    //
+    void frame_status(TPPM::FrameStamp &frame_stamp, uint32_t &good_frames);
+
     //------------------------------------//
     //                                    //
     // Superimposed Coding data accessors //
@@ -150,47 +335,58 @@ public:
 
 private:
     friend void TIMER1_CAPT_vect();
+    friend void PCINT0_vect();
+    friend void TIMER1_OVF_vect();
+    friend class TPPMSim;
 
-    enum
+    enum Buffer
     {
         ALT1_DATA_BUFFER = 0,
         ALT2_DATA_BUFFER    ,
         FAIL_SAFE_BUFFER    ,
         FRAME_BUFFERS
-    }
-    Buffer;
+    };
 
-    enum
+    enum SignalLevel
     {
         LO_LEVEL = 0,
         HI_LEVEL    ,
         SIGNAL_LEVELS
-    }
-    SignalLevel;
+    };
 
-    enum
+    enum Status
     {
         INIT_DECODE,
         SYNC_SEARCH,
         ACKNOWLEDGE,
         PPM_CAPTURE
-    }
-    Status;
+    };
 
-    enum
+    // The work left of the frame just ended, run on the next pulses ends
+    // (see commit_step())
+    //
+    enum Commit
+    {
+        COMMIT_NONE   = 0x00,
+        COMMIT_MODULE = 0x01, // decode its extra and on/off channels
+        COMMIT_LINK   = 0x02, // account it in the link quality indicators
+        COMMIT_AGES   = 0x04, // age the sub-module table in turn
+        COMMIT_ALL    = 0x07
+    };
+
+    enum SignatureBuffer
     {
         SIGNATURE_REF_DATA = 0,
         SIGNATURE_CUR_DATA    ,
         SIGNATURE_BUFFERS
-    }
-    SignatureBuffer;
+    };
 
-    class Signature
+    struct Signature
     {
         uint16_t min_width;
         uint16_t max_width;
-        uint16_t sum_width;
-        uint16_t captures;
+        TPPM::WidthSum sum_width;
+        uint8_t  captures;   // at most MAX_CHANNELS+1 edges per level
 
         Signature()
             : min_width(0)
@@ -216,18 +412,7 @@ private:
             ++captures;
         }
 
-        inline bool operator==(const Signal &ref)
-        {
-            return ARE_VERY_CLOSE(min_width, ref.min_width)
-                   &&
-                   ARE_VERY_CLOSE(max_width, ref.max_width)
-                   &&
-                   ARE_VERY_CLOSE(sum_width, ref.sum_width)
-                   &&
-                   (captures == ref.captures);
-        }
-
-        inline is_valid(const uint16_t &min_value, const uint16_t &max_value)
+        inline bool is_valid(const uint16_t &min_value, const uint16_t &max_value)
         {
             return IS_IN_RANGE(captures, MIN_CHANNELS, MAX_CHANNELS)
                    &&
@@ -239,7 +424,7 @@ private:
         }
     };
 
-    struct
+    struct Flags
     {
         uint8_t pulse_level_set : 1;
         uint8_t pulse_level     : 1;
@@ -248,31 +433,532 @@ private:
         uint8_t signature_buffer: 1;
         uint8_t entangled       : 1;
         uint8_t fail_safe_mode  : 1;
-    }
-    Flags;
-
-    Status        _state           ;
-    Flags         _flags           ;
-    uint16_t      _min_signal_width;
-    uint16_t      _max_signal_width;
+        uint8_t warm_start      : 1; // the fingerprint and the coupling are known
+        uint8_t warm_level      : 1; // and so is the pulse level
+        uint8_t frame_rejected  : 1; // a width out of range, skip to the sync
+        uint8_t edge_level      : 1; // the level the last edge left the line at
+        uint8_t timed_out       : 1; // no good frames within the watchdog timeout
+    };
 
+    Status        _state               ;
+    Flags         _flags               ;
+    uint16_t      _min_signal_width    ;
+    uint16_t      _max_signal_width    ;
+    uint32_t      _last_good_frame_time;
+    uint32_t      _last_sync_time      ;
+    uint16_t      _frame_period        ;
+    TPPM::FrameStamp _frame_stamp      ; // frames captured
+
+#if defined(TPPM_COMPACT_STORAGE)
+    Signature     _dsr[SIGNAL_LEVELS];     // pulses and gaps, shared by both frames
+    uint8_t       _ref_captures;           // the reference frame gaps
+#else
     Signature     _dsr[SIGNATURE_BUFFERS][SIGNAL_LEVELS];     // pulses and gaps
+#endif
 
-    uint16_t      _raw_channels[FRAME_BUFFERS][MAX_CHANNELS]; // 0: alt frame buffer
-                                                              // 1: alt frame buffer
-                                                              // 2: fail safe buffer
-    TPPM::ExtraChannels _extra_channels;
-    TPPM::OnOffChannels _onoff_channels;
+    // 0: alt frame buffer
+    // 1: alt frame buffer
+    // 2: fail safe buffer
+    //
+    TPPM::ChannelWord   _raw_channels[FRAME_BUFFERS][CHANNEL_WORDS(MAX_CHANNELS)];
+    TPPMModule          _modules[MODULE_TABLES];
     TPPMTag             _tag;
+    TPPMLink            _link;
+    TPPMFingerprint     _fingerprint;
+    uint8_t             _locks;
+    uint8_t             _missed_edges;
+    uint8_t             _commit       ; // stages left (see Commit)
+    bool                _commit_good  ; // the frame just ended was good...
+    uint16_t            _commit_width ; // ...its mean pulse width...
+    uint16_t            _commit_margin; // ...and its tag symbol margin
+#if defined(TPPM_CLOCK_REFERENCE_US)
+    uint16_t            _commit_period; // ...and its period, receiver ticks
+#endif
     uint8_t             _good_frames;
     uint8_t             _hold_frames;
 
-    inline uint16_t process(uint8_t  signal_level,
-                            uint16_t signal_width,
-                            uint16_t pulse_width )
+#if defined(TPPM_CLOCK_REFERENCE_US)
+    TPPMClock           _clock;
+#endif
+
+#if TRANSMITTERS > 1
+    TPPMTransmitter     _transmitters[TRANSMITTERS];
+    uint8_t             _active   ; // driving the outputs, NO_TRANSMITTER if unknown
+    uint8_t             _recent   ; // the last one come alive
+    uint8_t             _selected ; // encoder id (see TPPM::SELECT_EXPLICIT)
+    TPPM::Selection     _selection;
+
+    // Returns the table entry of the encoder id, NO_TRANSMITTER if unknown
+    //
+    inline uint8_t find_transmitter(const uint8_t &encoder_id)
+    {
+        for (uint8_t t=0; (0 != encoder_id) && (t < TRANSMITTERS); ++t)
+        {
+            if (_transmitters[t].encoder_id() == encoder_id)
+            {
+                return t;
+            }
+        }
+
+        return NO_TRANSMITTER;
+    }
+
+    // Returns true if the transmitter of the foreign frame just ended takes
+    // over the one driving the outputs, according to the selection
+    //
+    inline bool takes_over(const uint8_t &transmitter)
+    {
+        bool active_lost = (NO_TRANSMITTER == _active) || !_transmitters[_active].alive(_frame_stamp);
+
+        switch (_selection)
+        {
+            case TPPM::SELECT_PRIORITY:
+                return active_lost
+                       ||
+                       (_transmitters[transmitter].priority() < _transmitters[_active].priority());
+
+            case TPPM::SELECT_RECENT:
+                return active_lost || (_recent == transmitter);
+
+            default:
+                return _transmitters[transmitter].encoder_id() == _selected;
+        }
+    }
+
+    // A foreign frame for me has been captured: returns true if it comes from
+    // a known transmitter, which then drives the outputs if it takes over
+    //
+    inline bool foreign_frame(const uint16_t &sync_width)
     {
+        uint8_t transmitter = find_transmitter(_tag.encoder_id());
+
+        if (NO_TRANSMITTER == transmitter)
+        {
+            return false;
+        }
+
+        TPPMTransmitter &backup   = _transmitters[transmitter];
+        bool             appeared = !backup.alive(_frame_stamp);
+
+        if (!backup.frame(signature(!_flags.pulse_level).captures,
+                          _frame_period,
+                          sync_width   ,
+                          _raw_channels[!_flags.frame_buffer],
+                          _frame_stamp))
+        {
+            return false;
+        }
+
+        if ((GOOD_FRAMES_COUNT == backup.good_frames()) && !backup.fail_safe_set())
+        {
+            backup.learn_fail_safe();
+        }
+
+        if (appeared)
+        {
+            _recent = transmitter;
+        }
+
+        if (takes_over(transmitter))
+        {
+            // Keep the lock on the transmitter driving the outputs so far...
+            //
+            if (NO_TRANSMITTER != _active)
+            {
+                _transmitters[_active].save(_fingerprint,
+                                            _raw_channels[FAIL_SAFE_BUFFER],
+                                            _flags.fail_safe_set,
+                                            _raw_channels[_flags.frame_buffer]);
+            }
+
+            // ...and restore the one of the new transmitter
+            //
+            _fingerprint = backup.fingerprint();
+
+            if (backup.fail_safe_set())
+            {
+                for (uint8_t w=0; w < CHANNEL_WORDS(MAX_CHANNELS); w++)
+                {
+                    _raw_channels[FAIL_SAFE_BUFFER][w] = backup.fail_safe()[w];
+                }
+
+                _flags.fail_safe_set = 1;
+            }
+
+            _tag.adopt();
+
+            _active = transmitter;
+
+            ++_locks;
+        }
+
+        return true;
+    }
+
+    // Enter the transmitter just locked on in the table, if there is room
+    //
+    inline void locked_transmitter()
+    {
+        uint8_t encoder_id = _tag.coupled_id();
+
+        _active = find_transmitter(encoder_id);
+
+        for (uint8_t t=0; (0 != encoder_id) && (NO_TRANSMITTER == _active) && (t < TRANSMITTERS); ++t)
+        {
+            if (0 == _transmitters[t].encoder_id())
+            {
+                _transmitters[t].add(encoder_id, 0xff);
+
+                _active = t;
+            }
+        }
+
+        if (NO_TRANSMITTER != _active)
+        {
+            _transmitters[_active].seen(_frame_stamp);
+        }
+    }
+#endif
+
+    // Returns true if the frame just ended is for me from another known
+    // transmitter (see add_transmitter())
+    //
+    inline bool known_foreign()
+    {
+#if TRANSMITTERS > 1
+        return _tag.is_foreign() && (NO_TRANSMITTER != find_transmitter(_tag.encoder_id()));
+#else
+        return false;
+#endif
+    }
+
+    // Packed/unpacked access to the frame buffers (see TPPM_COMPACT_STORAGE)
+    //
+    inline uint16_t raw_channel(const uint8_t &buffer, const uint8_t &channel)
+    {
+        return TPPM::get_channel(_raw_channels[buffer], channel);
+    }
+
+    inline void set_raw_channel(const uint8_t &buffer, const uint8_t &channel, const uint16_t &width)
+    {
+        TPPM::set_channel(_raw_channels[buffer], channel, width);
+    }
+
+    inline void copy_raw_channels(const uint8_t &dst_buffer, const uint8_t &src_buffer)
+    {
+        for (uint8_t w=0; w < CHANNEL_WORDS(MAX_CHANNELS); w++)
+        {
+            _raw_channels[dst_buffer][w] = _raw_channels[src_buffer][w];
+        }
+    }
+
+    // Access to the pulses and gaps signature of the frame being captured
+    //
+    // With TPPM_COMPACT_STORAGE a single pair of accumulators is shared by
+    // the reference and the current frames: of the reference frame only the
+    // gaps count is used afterwards, and it is kept apart
+    //
+    inline Signature &signature(const uint8_t &level)
+    {
+#if defined(TPPM_COMPACT_STORAGE)
+        return _dsr[level];
+#else
+        return _dsr[_flags.signature_buffer][level];
+#endif
+    }
+
+    inline uint8_t reference_channels()
+    {
+#if defined(TPPM_COMPACT_STORAGE)
+        if (SIGNATURE_REF_DATA == _flags.signature_buffer)
+        {
+            return _dsr[!_flags.pulse_level].captures;
+        }
+
+        return _ref_captures;
+#else
+        return _dsr[SIGNATURE_REF_DATA][!_flags.pulse_level].captures;
+#endif
+    }
+
+    inline void reset_signatures()
+    {
+#if defined(TPPM_COMPACT_STORAGE)
+        _dsr[LO_LEVEL].reset();
+        _dsr[HI_LEVEL].reset();
+
+        _ref_captures = 0;
+#else
+        _dsr[SIGNATURE_REF_DATA][LO_LEVEL].reset();
+        _dsr[SIGNATURE_REF_DATA][HI_LEVEL].reset();
+
+        _dsr[SIGNATURE_CUR_DATA][LO_LEVEL].reset();
+        _dsr[SIGNATURE_CUR_DATA][HI_LEVEL].reset();
+#endif
+    }
+
+    // Latch the watchdog timeout, only a good frame clears it: the elapsed
+    // time is not trusted beyond the 32 bits timebase wrap around
+    //
+    inline bool watchdog(const uint32_t &now)
+    {
+        if ((now - _last_good_frame_time) >= WATCHDOG_TIMEOUT)
+        {
+            _flags.timed_out = 1;
+        }
+
+        return _flags.timed_out;
+    }
+
+    // Forget the frame being captured and search a sync gap
+    //
+    inline void init_decode()
+    {
+        // Do not refresh the watchdog here: a noisy line would keep the
+        // decoder re-initializing and the watchdog from ever expiring
+        //
+        _flags.fail_safe_mode  = 1;
+        _flags.frame_rejected  = 0;
+        _flags.pulse_level_set = 0;
+        _flags.pulse_level     = HI_LEVEL;
+        _min_signal_width      = MIN_GAP_WIDTH;
+        _max_signal_width      = MAX_GAP_WIDTH;
+        _good_frames           = 0;
+        _hold_frames           = 0;
+        _state                 = SYNC_SEARCH;
+    }
+
+    // A sync gap has been found, the frames following it identify the
+    // transmitter
+    //
+    inline void sync_found(const uint8_t &signal_level)
+    {
+        uint8_t coupled_id = _tag.coupled_id();
+
+        _tag.reset();
+
+        if (_flags.warm_start && (_flags.warm_level == (signal_level & HI_LEVEL)))
+        {
+            // Keep the transmitter's lock of the previous run
+            //
+            _tag.couple(coupled_id);
+        }
+        else
+        {
+            _flags.warm_start = 0;
+
+            _fingerprint.reset();
+        }
+
+        reset_signatures();
+
+        _flags.signature_buffer = SIGNATURE_REF_DATA;
+        _flags.pulse_level      = signal_level & HI_LEVEL;
+        _flags.pulse_level_set  = 1;
+        _flags.entangled        = 0;
+        _min_signal_width       = MIN_CHANNEL_WIDTH;
+        _max_signal_width       = MAX_CHANNEL_WIDTH;
+        _state                  = ACKNOWLEDGE;
+    }
+
+    // A width of the frame being captured is out of range: the frame is bad
+    // whatever its next edges are
+    //
+    inline void reject_frame()
+    {
+        if (ACKNOWLEDGE == _state)
+        {
+            // Learn the transmitter from scratch, from the sync gap ending
+            // this frame: the next frame is the first one
+            //
+            _flags.warm_start = 0;
+
+            init_decode();
+        }
+        else
+        {
+            // Keep the lock, the frame is accounted as a bad one at its sync
+            // gap
+            //
+            _flags.frame_rejected = 1;
+
+            _tag.reject();
+        }
+    }
+
+    // An edge of the frame has been missed, its signal is merged into the next
+    // one: the widths around it are wrong, not the transmitter. Skip the
+    // frame up to its sync gap as a bad one, keeping the lock or the frames
+    // learned so far.
+    //
+    inline void missed_edge()
+    {
+        ++_missed_edges;
+
+        _flags.frame_rejected = 1;
+
+        _tag.reject();
+    }
+
+    // Run the next stage of the work left of the frame just ended: its
+    // decision is taken at its sync gap, the rest waits for the gaps of the
+    // next frame, one stage per gap
+    //
+    // - stages : the stages to pick the next one from (see Commit)
+    //
+    inline void commit_step(const uint8_t &stages = COMMIT_ALL)
+    {
+        if (_commit & stages & COMMIT_MODULE)
+        {
+            _commit &= ~COMMIT_MODULE;
+
+            // Let's decode the extra channels of the addressed sub-module
+            // according to the superimposed tag: the frame is in the active
+            // frame buffer, the tag is not restarted before the next pulse
+            // ends
+            //
+            TPPMModule &module = _modules[MODULE_TABLE(_tag.part_index())];
+
+#if defined(TPPM_EXTRA_PREDICTOR)
+            module.refreshing(_tag.scan_index(), _frame_stamp);
+#endif
+
+            _tag.decode(_raw_channels[_flags.frame_buffer],
+                        module.extra_channels(),
+                        module.onoff_channels());
+
+            module.refreshed(_tag.refreshed_slots(), _frame_stamp);
+        }
+        else
+        if (_commit & stages & COMMIT_LINK)
+        {
+            _commit &= ~COMMIT_LINK;
+
+#if defined(TPPM_CLOCK_REFERENCE_US)
+            // The good frames periods are the reference of the transmitter clock
+            //
+            if (_commit_good)
+            {
+                _clock.frame(_commit_period);
+            }
+#endif
+
+            // Account the frame in the link quality indicators
+            //
+            _link.frame(_commit_good  ,
+                        _frame_period ,
+                        _commit_width ,
+                        _commit_margin);
+        }
+        else
+        if (_commit & stages & COMMIT_AGES)
+        {
+            _commit &= ~COMMIT_AGES;
+
+            // One table per frame, in turn
+            //
+            _modules[MODULE_TABLE(_frame_stamp)].age(_frame_stamp);
+        }
+    }
+
+    // Run the work left of the frame just ended: the channels and the
+    // indicators are then up to date
+    //
+    // - stages : the stages to run, the readers run the ones they depend on
+    //            only, the others are left to the next pulses ends
+    //
+    inline void commit(const uint8_t &stages = COMMIT_ALL)
+    {
+        while (_commit & stages)
+        {
+            commit_step(stages);
+        }
+    }
+
+    // Returns the stage a reader of a sub-module's table depends on, if the
+    // frame just ended was addressed to it
+    //
+    inline uint8_t module_stages(const uint8_t &module)
+    {
+        return (MODULE_TABLE(_tag.part_index()) == MODULE_TABLE(module)) ? COMMIT_MODULE : COMMIT_NONE;
+    }
+
+    // Returns the stages a reader of a sub-module table's ages depends on
+    //
+    inline uint8_t age_stages(const uint8_t &module)
+    {
+        return module_stages(module) | ((MODULE_TABLE(_frame_stamp) == MODULE_TABLE(module)) ? COMMIT_AGES : COMMIT_NONE);
+    }
+
+    inline uint16_t process(uint8_t         signal_level,
+                            uint16_t        signal_width,
+                            uint16_t        pulse_width ,
+                            const uint32_t &capture_time)
+    {
+#if defined(TPPM_CLOCK_REFERENCE_US)
+        // From here on the widths are in transmitter ticks, the pulse width
+        // returned already is
+        //
+        signal_width = _clock.scale(signal_width);
+#endif
+
+        // The signal_level is the one after the edge, the signal just ended had
+        // the opposite level: the pulses are accounted at the pulse level and the
+        // channels (gap plus pulse) at the gap level
+        //
+        uint8_t  ended_level   = !signal_level;
         uint16_t channel_width = signal_width + pulse_width;
-        uint8_t &channel       = _dsr[_flags.signature_buffer][signal_level].captures;
+        uint8_t &channel       = signature(ended_level).captures;
+
+        if (COMMIT_NONE != _commit)
+        {
+            if (IS_IN_RANGE(signal_width, MIN_SYNC_WIDTH, MAX_SYNC_WIDTH))
+            {
+                // Another frame ends already: finish the last one first
+                //
+                commit();
+            }
+            else
+            if ((signal_level & HI_LEVEL) != _flags.pulse_level)
+            {
+                // A pulse ends: the gap starting is the longest time to the
+                // next edge
+                //
+                commit_step();
+            }
+        }
+
+        if (_flags.pulse_level_set && (_state >= ACKNOWLEDGE) && ((signal_level & HI_LEVEL) == _flags.edge_level))
+        {
+            // The levels do not alternate: an edge has been missed
+            //
+            missed_edge();
+        }
+
+        _flags.edge_level = signal_level & HI_LEVEL;
+
+        if (_flags.frame_rejected && !IS_IN_RANGE(signal_width, MIN_SYNC_WIDTH, MAX_SYNC_WIDTH))
+        {
+            // The frame is already known bad: skip its edges up to the sync gap
+            //
+            return 0;
+        }
+
+        if (_flags.pulse_level_set && (_state >= ACKNOWLEDGE)
+            &&
+            ((signal_width < MIN_SYNC_WIDTH)
+             ? ((signal_level == _flags.pulse_level) ? !IS_IN_RANGE(channel_width, _min_signal_width, _max_signal_width)
+                                                     : !IS_IN_RANGE(signal_width , MIN_PULSE_WIDTH  , MAX_PULSE_WIDTH  ))
+             : (signal_width > MAX_SYNC_WIDTH)))
+        {
+            // A channel, a pulse or a gap out of the limits checked at the sync
+            // gap: the frame is bad right now, the decoder does not wait for
+            // the end of it
+            //
+            reject_frame();
+
+            return 0;
+        }
 
         if (signal_width < MIN_SYNC_WIDTH)
         {
@@ -287,16 +973,17 @@ private:
                     //
                     if (channel < MAX_CHANNELS)
                     {
-                        // Save the channel width in the current frame buffer
+                        // Save the channel width in the alternative frame buffer,
+                        // it becomes the current one if the frame is good
                         //
-                        _raw_channels[_flags.frame_buffer][channel] = channel_width;
+                        set_raw_channel(!_flags.frame_buffer, channel, channel_width);
                     }
                 }
             }
 
             // Update the Digital Signature data
             //
-            _dsr[_flags.signature_buffer][signal_level].update(channel_width);
+            signature(ended_level).update(channel_width);
         }
 
         if (_flags.pulse_level_set)
@@ -317,22 +1004,64 @@ private:
                 pulse_width = signal_width;
 
                 _tag.update(channel, signal_width);
+
+                if (ACKNOWLEDGE == _state)
+                {
+                    _fingerprint.pulse(channel, signal_width);
+                }
             }
         }
 
-        bool sync_detected = IS_IN_RANGE(signal_width, MIN_SYNC_WIDTH, MAX_SYNC_WIDTH);
+        bool     sync_detected    = IS_IN_RANGE(signal_width, MIN_SYNC_WIDTH, MAX_SYNC_WIDTH);
+        bool     frame_ended      = sync_detected && (_state >= ACKNOWLEDGE);
+        bool     good_frame       = false;
+        uint16_t mean_pulse_width = 0;
+#if defined(TPPM_CLOCK_REFERENCE_US)
+        uint16_t receiver_period  = 0;
+#endif
+
+        if (sync_detected)
+        {
+            // The sync gap ends here, so does the frame: measure it
+            //
+            uint32_t frame_period = capture_time - _last_sync_time;
+
+            _frame_period   = (frame_period > MAX_SIGNAL_WIDTH) ? MAX_SIGNAL_WIDTH : frame_period;
+            _last_sync_time = capture_time;
+
+#if defined(TPPM_CLOCK_REFERENCE_US)
+            receiver_period = _frame_period;
+            _frame_period   = _clock.scale(_frame_period);
+#endif
+
+            if (frame_ended)
+            {
+                ++_frame_stamp;
+
+                if ((ACKNOWLEDGE == _state) && (SIGNATURE_REF_DATA == _flags.signature_buffer))
+                {
+                    // The first frame of the transmitter selects the layout
+                    // its tag and multiplexed channels are decoded with
+                    //
+                    _tag.set_layout(TPPMTag::detect_layout(signature(!_flags.pulse_level).captures,
+                                                           signal_width));
+                }
+
+                _tag.sync(signal_width);
+                _tag.finish();
+            }
+
+            if (frame_ended && (0 != signature(_flags.pulse_level).captures))
+            {
+                mean_pulse_width = signature(_flags.pulse_level).sum_width
+                                   /
+                                   signature(_flags.pulse_level).captures;
+            }
+        }
 
         if (INIT_DECODE == _state)
         {
-            _last_good_frame_time  = millis();
-            _flags.fail_safe_mode  = 1;
-            _flags.pulse_level_set = 0;
-            _flags.pulse_level     = HI_LEVEL;
-            _min_signal_width      = MIN_GAP_WIDTH;
-            _max_signal_width      = MAX_GAP_WIDTH;
-            _good_frames           = 0;
-            _hold_frames           = 0;
-            _state                 = SYNC_SEARCH;
+            init_decode();
         }
 
         if (SYNC_SEARCH == _state)
@@ -341,21 +1070,12 @@ private:
             //
             if (sync_detected)
             {
-                _tag.reset();
-
-                _dsr[SIGNATURE_REF_DATA][LO_LEVEL].reset();
-                _dsr[SIGNATURE_REF_DATA][HI_LEVEL].reset();
-
-                _dsr[SIGNATURE_CUR_DATA][LO_LEVEL].reset();
-                _dsr[SIGNATURE_CUR_DATA][HI_LEVEL].reset();
+                // The sync gap is followed by a pulse: drop any pulse width
+                // saved while searching, it would be added to the first one
+                //
+                pulse_width = 0;
 
-                _flags.signature_buffer = SIGNATURE_REF_DATA;
-                _flags.pulse_level      = signal_level & HI_LEVEL;
-                _flags.pulse_level_set  = 1;
-                _flags.entangled        = 0;
-                _min_signal_width       = MIN_CHANNEL_WIDTH;
-                _max_signal_width       = MAX_CHANNEL_WIDTH;
-                _state                  = ACKNOWLEDGE;
+                sync_found(signal_level);
             }
         }
         else
@@ -366,31 +1086,53 @@ private:
             if (sync_detected)
             {
                 // A sync signal has been detected, let's analyze the frame in order to find if
-                // it matches the reference one
-                // (or set it as the reference if it's good and it's the first one)
+                // it matches the transmitter's fingerprint
+                // (or learn it if it's good and it's the first one)
                 //
+                if (_flags.frame_rejected || _tag.is_pending() || known_foreign())
+                {
+                    // A frame with a missed edge, a frame for my decoder id
+                    // before the page select telling if it is for me (see
+                    // TPPM_EXTENDED_ADDRESS), or from another known
+                    // transmitter: skip it, instead of learning the
+                    // transmitter from scratch
+                    //
+                    signature(LO_LEVEL).reset();
+                    signature(HI_LEVEL).reset();
+                }
+                else
                 if (_flags.pulse_level_set
                     &&
-                    (_dsr[_flags.signature_buffer][ _flags.pulse_level].is_valid(MIN_PULSE_WIDTH  , MAX_PULSE_WIDTH  )
+                    signature( _flags.pulse_level).is_valid(MIN_PULSE_WIDTH  , MAX_PULSE_WIDTH  )
                     &&
-                    (_dsr[_flags.signature_buffer][!_flags.pulse_level].is_valid(_min_signal_width, _max_signal_width)
+                    signature(!_flags.pulse_level).is_valid(_min_signal_width, _max_signal_width)
                     &&
-                    (_dsr[_flags.signature_buffer][!_flags.pulse_level].captures == (_dsr[_flags.signature_buffer][_flags.pulse_level].captures - 1))
+                    (signature(!_flags.pulse_level).captures == (signature(_flags.pulse_level).captures - 1))
                     &&
-                    (_dsr[_flags.signature_buffer][LO_LEVEL] == _dsr[SIGNATURE_REF_DATA][LO_LEVEL])
+                    (!_tag.is_encoded() || ((_tag.is_valid() || _tag.is_paging()) && !_tag.is_corrected()))
                     &&
-                    (_dsr[_flags.signature_buffer][HI_LEVEL] == _dsr[SIGNATURE_REF_DATA][HI_LEVEL])
+                    (!_flags.warm_start || (_tag.is_encoded() == (0 != _tag.coupled_id())))
                     &&
-                    (!_tag.is_encoded() || _tag.is_valid()))
+                    _fingerprint.frame(signature(!_flags.pulse_level).captures,
+                                       _frame_period,
+                                       signal_width ,
+                                       _tag.is_encoded()))
                 {
                     // A good frame has been captured, we need to collect a few of them
                     // in order to be sure we are entangled to the transmitter
                     //
                     ++_good_frames;
 
+                    good_frame = true;
+
                     // Refresh the watchdog
                     //
-                    _last_good_frame_time = millis();
+                    _last_good_frame_time = capture_time;
+                    _flags.timed_out      = 0;
+
+                    // Switch the active frame buffer to the one just captured
+                    //
+                    _flags.frame_buffer = !_flags.frame_buffer;
 
                     if (SIGNATURE_REF_DATA == _flags.signature_buffer)
                     {
@@ -399,15 +1141,18 @@ private:
                         //
                         _tag.connect();
 
+#if defined(TPPM_COMPACT_STORAGE)
+                        _ref_captures = _dsr[!_flags.pulse_level].captures;
+#endif
                         _flags.signature_buffer = SIGNATURE_CUR_DATA;
 
-                        _flags.entangled = _tag.is_valid();
+                        _flags.entangled = _tag.is_valid() || _tag.is_paging();
                     }
 
-                    _dsr[_flags.signature_buffer][LO_LEVEL].reset();
-                    _dsr[_flags.signature_buffer][HI_LEVEL].reset();
+                    signature(LO_LEVEL).reset();
+                    signature(HI_LEVEL).reset();
 
-                    if (GOOD_FRAMES_COUNT <= _good_frames)
+                    if (((_flags.warm_start) ? WARM_FRAMES_COUNT : GOOD_FRAMES_COUNT) <= _good_frames)
                     {
                         // A number of consecutive good frames has been captured
                         //
@@ -416,17 +1161,27 @@ private:
                             // Fail safe channels values have not yet been saved
                             // save them now
                             //
-                            for (uint8_t ch=0; ch < MAX_CHANNELS; ch++)
-                            {
-                                _raw_channels[FAIL_SAFE_BUFFER][ch] = _raw_channels[_flags.frame_buffer][ch];
-                            }
+                            copy_raw_channels(FAIL_SAFE_BUFFER, _flags.frame_buffer);
 
                             _flags.fail_safe_set = true;
                         }
 
+                        // The transmitter's symbol levels are learned, just track
+                        // their drift from now on
+                        //
+                        _tag.learn(false);
+
                         // We can now collect frames for real use
                         //
                         _state = PPM_CAPTURE;
+
+                        _flags.warm_start = 0;
+
+                        ++_locks;
+
+#if TRANSMITTERS > 1
+                        locked_transmitter();
+#endif
                     }
 
                     _flags.fail_safe_mode = 0;
@@ -434,8 +1189,14 @@ private:
                 else
                 {
                     // A mismatching frame has been captured, re-init the decoder
+                    // and learn the transmitter from scratch, starting from the
+                    // sync gap just ended: the next frame is not lost searching
+                    // for it
                     //
-                    _state = INIT_DECODE;
+                    _flags.warm_start = 0;
+
+                    init_decode();
+                    sync_found(signal_level);
                 }
             }
         }
@@ -446,14 +1207,50 @@ private:
             {
                 if (_flags.pulse_level_set)
                 {
-                    if (_dsr[_flags.signature_buffer][ _flags.pulse_level].is_valid(MIN_PULSE_WIDTH  , MAX_PULSE_WIDTH  )
+                    if (!_flags.frame_rejected
                         &&
-                        _dsr[_flags.signature_buffer][!_flags.pulse_level].is_valid(_min_signal_width, _max_signal_width)
+                        signature( _flags.pulse_level).is_valid(MIN_PULSE_WIDTH  , MAX_PULSE_WIDTH  )
                         &&
-                        (_dsr[_flags.signature_buffer][!_flags.pulse_level].captures == (_dsr[_flags.signature_buffer][_flags.pulse_level].captures - 1)))
+                        signature(!_flags.pulse_level).is_valid(_min_signal_width, _max_signal_width)
+                        &&
+                        (signature(!_flags.pulse_level).captures == (signature(_flags.pulse_level).captures - 1)))
                     {
                         // It's a good frame
                         //
+                        good_frame = !_tag.is_encoded() || _tag.is_trusted();
+
+#if TRANSMITTERS > 1
+                        if (_tag.is_foreign())
+                        {
+                            // For me from another transmitter: a known one may
+                            // take over, its frame is then valid
+                            //
+                            good_frame = foreign_frame(signal_width);
+                        }
+
+                        if (_tag.is_trusted() && (NO_TRANSMITTER != _active))
+                        {
+                            _transmitters[_active].seen(_frame_stamp);
+                        }
+#endif
+
+#if !defined(TPPM_TAG_FEC)
+                        if (_flags.entangled && _tag.is_valid() && _tag.is_corrected())
+                        {
+                            // For me, but recovered by the soft decision: the
+                            // parity alone may have validated the wrong symbols,
+                            // so the frame only keeps the link alive and the last
+                            // good frame stays in use
+                            //
+                            _last_good_frame_time = capture_time;
+                            _flags.timed_out      = 0;
+
+                            _hold_frames = 0;
+
+                            _flags.fail_safe_mode = 0;
+                        }
+                        else
+#endif
                         if (!_flags.entangled || (_tag.is_encoded() && _tag.is_valid()))
                         {
                             // And it's for me...
@@ -461,31 +1258,25 @@ private:
 
                             // ...refresh the watchdog
                             //
-                            _last_good_frame_time = millis();
+                            _last_good_frame_time = capture_time;
+                            _flags.timed_out      = 0;
 
                             // ...and reset the hold frames counter...
                             //
                             _hold_frames = 0;
 
-                            // Keep in sync the alternative frame buffer with the current one
+                            // The frame has been captured in the alternative frame buffer
                             //
-                            uint8_t old_frame_buffer =  _flags.frame_buffer;
                             uint8_t new_frame_buffer = !_flags.frame_buffer;
 
-                            for (uint8_t ch=0; ch < MAX_CHANNELS; ch++)
-                            {
-                                _raw_channels[new_frame_buffer][ch] = _raw_channels[old_frame_buffer][ch];
-                            }
-
                             if (_flags.entangled)
                             {
                                 // I'm entangled
                                 //
-                                // Let's decode the extra channels according to the superimposed tag
+                                // The extra channels of the addressed sub-module are
+                                // decoded at the end of the next pulse
                                 //
-                                _tag.decode(_raw_channels[new_frame_buffer],
-                                            _extra_channels,
-                                            _onoff_channels);
+                                _commit |= COMMIT_MODULE;
                             }
 
                             // Switch the active frame buffer
@@ -516,7 +1307,8 @@ private:
                             {
                                 // Refresh the watchdog
                                 //
-                                _last_good_frame_time = millis();
+                                _last_good_frame_time = capture_time;
+                                _flags.timed_out      = 0;
                             }
                             // else: an unentangled encoder is transmitting in the receiver's frequency
                             //       do NOT refresh the watchdog!
@@ -560,9 +1352,34 @@ private:
                     //
                     _state = INIT_DECODE;
                 }
+
+                // Start collecting the next frame's signature
+                //
+                signature(LO_LEVEL).reset();
+                signature(HI_LEVEL).reset();
             }
         }
 
+        if (frame_ended)
+        {
+            // The frame just ended is accounted in the link quality indicators,
+            // and a sub-module table aged, at the ends of the next pulses
+            //
+            _commit_good   = good_frame;
+            _commit_width  = mean_pulse_width;
+            _commit_margin = (_tag.is_encoded()) ? _tag.symbol_margin() : LINK_FULL_MARGIN;
+#if defined(TPPM_CLOCK_REFERENCE_US)
+            _commit_period = receiver_period;
+#endif
+            _commit       |= COMMIT_LINK | COMMIT_AGES;
+
+            _tag.restart();
+
+            // The next frame is checked again
+            //
+            _flags.frame_rejected = 0;
+        }
+
         return pulse_width;
     }
 };
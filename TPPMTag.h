@@ -1,7 +1,20 @@
 #if !defined(__TPPM_TAG_H__)
 #define __TPPM_TAG_H__
 
-#include "TPPMCfg.h"
+#include "TPPMLevels.h"
+#include "TPPMTagCode.h"
+
+// Frame layouts carrying a superimposed tag, detected from the frames:
+//
+// - 8 channels  (doc/Codes8ch.txt) : 9 tag pulses, at least a 4 ms sync gap,
+//                                    an on/off nibble channel
+// - 10 channels (doc/Codes10ch.txt): 11 tag pulses, three on/off pair channels
+//
+// any other frame is plain PPM.
+//
+#define LAYOUT_8CH_CHANNELS       8
+#define LAYOUT_8CH_MIN_SYNC       USEC_TO_WIDTH( 4000 - GUARD_US )
+#define LAYOUT_10CH_CHANNELS      10
 
 #define MAX_SUPERINPOSED_CHANNELS 11
 
@@ -10,31 +23,127 @@
 #define INVALID_PATTERN_10        0b00000000001010101010101010101010
 #define INVALID_PATTERN_11        0b00000000001111111111111111111111
 
-#define MIN_CODE_THRESHOLD        USEC_TO_WIDTH( 300 ) // MIN_PULSE_WIDTH
-#define MAX_CODE_THRESHOLD        USEC_TO_WIDTH( 460 ) // MAX_PULSE_WIDTH
-#define CODE_THRESHOLD_STEP       ( ( MAX_CODE_THRESHOLD - MIN_CODE_THRESHOLD ) / 4 )
-
-#define CODE_THRESHOLD_00         ( MIN_CODE_THRESHOLD + CODE_THRESHOLD_STEP )
-#define CODE_THRESHOLD_01         ( CODE_THRESHOLD_00  + CODE_THRESHOLD_STEP )
-#define CODE_THRESHOLD_10         ( CODE_THRESHOLD_01  + CODE_THRESHOLD_STEP )
-
 #define BIT_VAL(word,bit_pos)     (((word) >> (bit_pos)) & 0x01)
 
+// The tag bits carried by a symbol level: Gray coded with TPPM_TAG_FEC, so
+// that adjacent levels differ by a single bit (it is its own inverse)
+//
+#if defined(TPPM_TAG_FEC)
+#define SYMBOL_BITS(level)        ( (level) ^ ( (level) >> 1 ) )
+#else
+#define SYMBOL_BITS(level)        (level)
+#endif
+
 #define ONOFF_THRESHOLD_STEP      ( ( MAX_CHANNEL_WIDTH - MIN_CHANNEL_WIDTH ) / 4 )
 
 #define ONOFF_THRESHOLD_00        ( MIN_CHANNEL_WIDTH  + ONOFF_THRESHOLD_STEP )
 #define ONOFF_THRESHOLD_01        ( ONOFF_THRESHOLD_00 + ONOFF_THRESHOLD_STEP )
 #define ONOFF_THRESHOLD_10        ( ONOFF_THRESHOLD_01 + ONOFF_THRESHOLD_STEP )
 
+// The 8 channels layout's on/off nibble channel: 16 levels
+//
+#define ONOFF_NIBBLE_STEP         ( ( MAX_CHANNEL_WIDTH - MIN_CHANNEL_WIDTH ) / 16 )
+#define ONOFF_NIBBLE_CHANNELS     ( ONOFF_SCAN_SLOTS * 4 )
+
+// Soft decision: when the tag check fails, it is retried with up to the
+// SOFT_DECISION_SYMBOLS least confident symbols moved to their neighbour
+// level, if their pulses were within SOFT_DECISION_MARGIN of the threshold
+//
+#define SOFT_DECISION_SYMBOLS     2
+#define SOFT_DECISION_MARGIN      ( CODE_THRESHOLD_STEP / 4 )
+
+// 8 levels symbols (see TPPM_TAG_8_LEVELS): each symbol level is split in two
+// halves, the half of every pulse is a third bit. The third bits carry the
+// on/off channels of a second scan slot, HIGH_ORDER_SLOT(), and a check
+// bound to the scan index. They are trusted only if all the pulses of the
+// frame lie at least HIGH_ORDER_MIN_MARGIN from the middle of their level:
+// on a noisy link, or with a 4 levels transmitter, the frame is decoded on 4
+// levels only.
+//
+#define HIGH_ORDER_MIN_MARGIN     USEC_TO_WIDTH( 4 )
+#define HIGH_ORDER_CHECK_BITS     5
+#define HIGH_ORDER_CHECK_POLY     0x05
+#define HIGH_ORDER_DATA_BITS(pulses)     ( (pulses) - HIGH_ORDER_CHECK_BITS )
+#define HIGH_ORDER_SLOT(scan)            ( ( (scan) ^ ( ONOFF_SCAN_SLOTS >> 1 ) ) & ( ONOFF_SCAN_SLOTS - 1 ) )
+
+// Sync gap symbols (see TPPM_SYNC_SYMBOLS): the sync gap width, in steps of
+// SYNC_SYMBOL_STEP, modulo SYNC_SYMBOL_LEVELS is a symbol carrying the on/off
+// channels of a further scan slot, SYNC_SLOT(), in its high bits and a check
+// in its low ones (see sync_check()). The symbol is trusted only if the width
+// lies within SYNC_SYMBOL_MARGIN of the symbol step and the check matches: a
+// width a few steps off, within the margin of another symbol, fails it.
+//
+#define SYNC_SYMBOL_BITS          7
+#define SYNC_SYMBOL_LEVELS        ( 1 << SYNC_SYMBOL_BITS )
+#define SYNC_SYMBOL_STEP          USEC_TO_WIDTH( 16 )
+#define SYNC_SYMBOL_MARGIN        ( SYNC_SYMBOL_STEP / 4 )
+
+#if defined(TPPM_TAG_8_LEVELS)
+#define SYNC_SLOT(scan)           ( (scan) ^ ( ONOFF_SCAN_SLOTS >> 2 ) )
+#else
+#define SYNC_SLOT(scan)           ( (scan) ^ ( ONOFF_SCAN_SLOTS >> 1 ) )
+#endif
+
+// Extended addressing (see TPPM_EXTENDED_ADDRESS): a decoder id is a 4 bits
+// tag decoder id and an 8 bits page. The page is sent in EXTENDED_PAGE_FRAMES
+// consecutive page select frames, tagged with the decoder id EXTENDED_PAGE_ID,
+// each carrying a nibble of it in the part index and its sequence number in
+// the scan index. The frames following a complete page select are addressed
+// to that page, until the next one. The transmitter repeats the page select
+// every EXTENDED_PAGE_PERIOD frames: the decoder forgets the page on a bad
+// frame, a broken sequence or after EXTENDED_PAGE_TIMEOUT frames without a
+// page select.
+//
+#define EXTENDED_PAGE_ID          0x0f
+#define EXTENDED_PAGE_BITS        8
+#define EXTENDED_PAGE_FRAMES      ( EXTENDED_PAGE_BITS / 4 )
+#define EXTENDED_PAGE_PERIOD      16
+#define EXTENDED_PAGE_TIMEOUT     ( ( EXTENDED_PAGE_PERIOD + EXTENDED_PAGE_FRAMES ) * 2 )
+
+#define EXTENDED_PAGE(decoder_id)        ( ( (decoder_id) >> 4 ) & ( ( 1 << EXTENDED_PAGE_BITS ) - 1 ) )
+
 #define MUXED_CHANNLES            3
 #define FIRST_EXTRA_CHANNEL       4
 #define FIRST_ONOFF_CHANNEL       7
 
+// Scan slots: the extra channels are refreshed every 4 scan indexes,
+// the on/off channels every 8
+//
+#define EXTRA_SCAN_SLOTS          4
+#define ONOFF_SCAN_SLOTS          8
+
+// Refreshed slots masks (see TPPMTag::refreshed_slots()): the on/off scan
+// slots, then the extra ones. The further slots carried by the third bits or
+// by the sync gap symbol refresh on/off channels only
+//
+#define REFRESH_SLOTS             ( ONOFF_SCAN_SLOTS + EXTRA_SCAN_SLOTS )
+#define EXTRA_REFRESH_SLOT(scan)  ( ONOFF_SCAN_SLOTS + ( (scan) & ( EXTRA_SCAN_SLOTS - 1 ) ) )
+
+#define EXTRA_SCAN_SLOT(channel)         ( (channel) & ( EXTRA_SCAN_SLOTS - 1 ) )
+#define ONOFF_SCAN_BYTE(muxed,scan)      ( ( (muxed) << 1 ) + ( ( (scan) & 4 ) >> 2 ) )
+#define ONOFF_SCAN_SLOT(channel)         ( ( ( (channel) & 0x08 ) >> 1 ) | ( ( (channel) & 0x07 ) >> 1 ) )
+
+// The 8 channels layout's on/off channels: a nibble per scan index
+//
+#define ONOFF_NIBBLE_BYTE(scan)          ( (scan) >> 1 )
+#define ONOFF_NIBBLE_SHIFT(scan)         ( ( (scan) & 1 ) << 2 )
+#define ONOFF_NIBBLE_SLOT(channel)       ( (channel) >> 2 )
+
 class TPPMTag
 {
 public:
+    enum Layout
+    {
+        LAYOUT_PLAIN = 0,
+        LAYOUT_8CH      ,
+        LAYOUT_10CH
+    };
+
     TPPMTag()
-        ; _raw_bits  (0)
+        : _layout    (LAYOUT_10CH)
+        , _pulses    (0)
+        , _symbols   (false)
+        , _raw_bits  (0)
         , _coupled_id(0)  // until coupled all transmitters are valid
         , _encoder_id(0)
         , _decoder_id(0)
@@ -42,216 +151,512 @@ public:
         , _scan_index(0)
         , _valid     (false)
         , _trusted   (false)
+        , _foreign   (false)
         , _encoded   (false)
+        , _corrected (false)
+        , _margin    (0xffff)
+        , _foreign_part(0)
+        , _foreign_scan(0)
+#if defined(TPPM_TAG_8_LEVELS)
+        , _extended  (false)
+        , _half_bits (0)
+        , _half_data (0)
+        , _headroom  (0)
+#endif
+#if defined(TPPM_SYNC_SYMBOLS)
+        , _synced    (false)
+        , _sync_data (0)
+        , _sync_error(0)
+#endif
+#if defined(TPPM_EXTENDED_ADDRESS)
+        , _page_id   (0)
+        , _page_tx   (0)
+        , _page      (0)
+        , _page_next (0)
+        , _page_age  (0)
+        , _paged     (false)
+        , _paging    (false)
+        , _pending   (false)
+#endif
     {}
 
+    // Forget the transmitter, the decoder id set is kept
+    //
     inline void reset()
     {
         _raw_bits   = 0;
         _coupled_id = 0;
         _encoder_id = 0;
-        _decoder_id = 0;
         _part_index = 0;
         _scan_index = 0;
         _valid      = false;
         _trusted    = false;
+        _foreign    = false;
         _encoded    = false;
+        _corrected  = false;
+        _margin     = 0xffff;
+#if defined(TPPM_TAG_8_LEVELS)
+        _extended   = false;
+#endif
+#if defined(TPPM_SYNC_SYMBOLS)
+        _synced     = false;
+#endif
+
+        // The learned symbol levels and the selected page (bound to its
+        // transmitter, see TPPM_EXTENDED_ADDRESS) survive a reset, the
+        // transmitter is likely the same, but the levels are learned again
+        //
+        _levels.learn(true);
+    }
+
+    // Learn the transmitter's symbol levels fast (true) or just track their
+    // slow drift (false)
+    //
+    inline void learn(const bool &learning)
+    {
+        _levels.learn(learning);
     }
 
-    inline void set_decoder_id(const uint8_t &decoder_id)
+    // Set the decoder id the frames must be addressed to: 4 bits, 12 with
+    // TPPM_EXTENDED_ADDRESS (the page in the 8 high bits)
+    //
+    inline void set_decoder_id(const uint16_t &decoder_id)
     {
-        _decoder_id = decoder_id & 0x07;
+        _decoder_id = decoder_id & 0x0f;
+#if defined(TPPM_EXTENDED_ADDRESS)
+        _page_id    = EXTENDED_PAGE(decoder_id);
+#endif
     }
 
+    // Returns the layout of a frame with the given channels and sync gap
+    //
+    static inline Layout detect_layout(const uint8_t &channels, const uint16_t &sync_width)
+    {
+        if (LAYOUT_10CH_CHANNELS == channels)
+        {
+            return LAYOUT_10CH;
+        }
+
+        if ((LAYOUT_8CH_CHANNELS == channels) && (sync_width >= LAYOUT_8CH_MIN_SYNC))
+        {
+            return LAYOUT_8CH;
+        }
+
+        return LAYOUT_PLAIN;
+    }
+
+    // Select the frame layout the tag and the multiplexed channels are
+    // decoded with
+    //
+    inline void set_layout(const Layout &layout)
+    {
+        _layout = layout;
+    }
+
+    inline Layout layout()
+    {
+        return _layout;
+    }
+
+    // Returns the number of tag pulses of the layout, 0 for plain PPM
+    //
+    inline uint8_t tag_pulses()
+    {
+        return (LAYOUT_10CH == _layout) ? (LAYOUT_10CH_CHANNELS + 1) :
+               (LAYOUT_8CH  == _layout) ? (LAYOUT_8CH_CHANNELS  + 1) : 0;
+    }
+
+    // Returns the number of on/off channels carried by the layout
+    //
+    inline uint8_t onoff_channels_count()
+    {
+        return (LAYOUT_10CH == _layout) ? ONOFF_CHANNELS_COUNT  :
+               (LAYOUT_8CH  == _layout) ? ONOFF_NIBBLE_CHANNELS : 0;
+    }
+
+    // Returns the scan index refreshing the on/off channel
+    //
+    inline uint8_t onoff_scan_slot(const uint8_t &channel)
+    {
+        return (LAYOUT_8CH == _layout) ? ONOFF_NIBBLE_SLOT(channel) : ONOFF_SCAN_SLOT(channel);
+    }
+
+    // Returns the tag bits carried by a symbol level in the layout: Gray coded
+    // in the 10 channels layout with TPPM_TAG_FEC
+    //
+    static inline uint8_t symbol_bits(const Layout &layout, const uint8_t &level)
+    {
+        return (LAYOUT_10CH == layout) ? SYMBOL_BITS(level) : level;
+    }
+
+    // Collect the symbol of a pulse of the frame, the tag is checked by
+    // finish() at the frame's end.
+    //
+    // - captures    : the pulses captured so far in the frame, this one included
+    // - pulse_width : the width of this pulse
+    //
     inline void update(const uint8_t &captures, const uint16_t &pulse_width)
     {
-        _trusted = false;
+        _pulses = captures;
+
+        if (1 == captures)
+        {
+            // First pulse of a new frame: forget the previous frame's tag
+            //
+            _raw_bits  = 0;
+            _symbols   = true;
+            _valid     = false;
+            _trusted   = false;
+            _encoded   = false;
+            _corrected = false;
+#if defined(TPPM_TAG_8_LEVELS)
+            _extended  = false;
+            _half_bits = 0;
+            _headroom  = 0xffff;
+#endif
+
+            for (uint8_t w=0; w<SOFT_DECISION_SYMBOLS; ++w)
+            {
+                _weak[w].margin = 0xffff;
+            }
+
+            _levels.discard();
+        }
 
         if (captures <= MAX_SUPERINPOSED_CHANNELS)
         {
             // collect data
             //
-            if (IS_IN_RANGE(pulse_width,MIN_CODE_THRESHOLD,MAX_CODE_THRESHOLD))
+            if (_levels.is_symbol(pulse_width))
             {
                 // It's a valid pulse with superinposed code
                 //
-                uint8_t bit_index = (captures << 1);
+                uint8_t bit_index = ((captures - 1) << 1);
+                uint8_t symbol    = _levels.quantize(pulse_width);
 
-                // clear the bits
+                // Follow the transmitter's symbol levels, once the tag is
+                // checked (see finish())
                 //
-                _raw_bits &= ~(0x11 << bit_index);
+                _levels.track(pulse_width, symbol);
 
-                // set the bits
+                // Keep the worst symbol margin of the frame
                 //
-                if (pulse_width >= CODE_THRESHOLD_10)
+                uint16_t margin = _levels.margin(pulse_width, symbol);
+
+                if (margin < _margin)
                 {
-                    _raw_bits |= (0x11 << bit_index);
+                    _margin = margin;
                 }
-                else
-                if (pulse_width >= CODE_THRESHOLD_01)
+
+                // Keep the least confident symbols for the soft decision
+                //
+                uint8_t neighbour;
+
+                margin = _levels.confidence(pulse_width, symbol, neighbour);
+
+                weak_symbol(captures - 1, margin, neighbour);
+
+                // clear the bits
+                //
+                _raw_bits &= ~((uint32_t)0x03 << bit_index);
+
+                // set the bits: the symbol level, turned into the tag bits
+                // by finish() once the layout is known
+                //
+                _raw_bits |= ((uint32_t)symbol << bit_index);
+
+#if defined(TPPM_TAG_8_LEVELS)
+                // The third bit: the half of the level the pulse lies in
+                //
+                if (_levels.half(pulse_width, symbol, margin))
                 {
-                    _raw_bits |= (0x10 << bit_index);
+                    _half_bits |= (1 << (captures - 1));
                 }
-                else
-                if (pulse_width >= CODE_THRESHOLD_00)
+
+                if (margin < _headroom)
                 {
-                    _raw_bits |= (0x01 << bit_index);
+                    _headroom = margin;
                 }
+#endif
             }
             else
             {
                 // invalid data -> invalidate the tag
                 //
-                _raw_bits = 0;
+                _symbols = false;
             }
         }
-        else
-        if (captures == MAX_SUPERINPOSED_CHANNELS)
-        {
-            bool valid = false;
+    }
+
+    // A width of the frame is out of range, its next pulses are not
+    // collected: finish() finds no tag in it
+    //
+    inline void reject()
+    {
+        _symbols = false;
+    }
 
-            _raw_bits &= INVALID_PATTERN_11; // mask off all the extra bits
+    // Collect the symbol of the sync gap ending the frame, before finish()
+    // (see TPPM_SYNC_SYMBOLS)
+    //
+    inline void sync(const uint16_t &sync_width)
+    {
+#if defined(TPPM_SYNC_SYMBOLS)
+        uint16_t steps  = (sync_width + (SYNC_SYMBOL_STEP / 2)) / SYNC_SYMBOL_STEP;
+        uint16_t center = steps * SYNC_SYMBOL_STEP;
+
+        _sync_data  = steps & (SYNC_SYMBOL_LEVELS - 1);
+        _sync_error = (sync_width > center) ? (sync_width - center) : (center - sync_width);
+#else
+        (void)sync_width;
+#endif
+    }
 
-            // We have reached the maximum number of coded pulses
+    // Check the tag of the frame just ended, in the selected layout
+    //
+    inline void finish()
+    {
+        uint8_t  pulses = tag_pulses();
+        uint32_t mask   = ((uint32_t)1 << (pulses << 1)) - 1;
+        bool     valid  = false;
+
+        // A tag only if the frame has exactly the layout's pulses, all of them
+        // symbols
+        //
+        _encoded = (0 != pulses) && (_pulses == pulses) && _symbols;
+
+        if (_encoded)
+        {
+            // In an unencoded PPM all the pulses have the same width
             //
-            _encoded = ! ARE_VERY_CLOSE(_pulse.min_width, _pulse.max_width)
-                       &&
-                       ( _raw_bits != INVALID_PATTERN_00 )
+            _raw_bits &= mask;
+
+            _encoded = ( _raw_bits != ( INVALID_PATTERN_00 & mask ) )
                        &&
-                       ( _raw_bits != INVALID_PATTERN_01 )
+                       ( _raw_bits != ( INVALID_PATTERN_01 & mask ) )
                        &&
-                       ( _raw_bits != INVALID_PATTERN_10 )
+                       ( _raw_bits != ( INVALID_PATTERN_10 & mask ) )
                        &&
-                       ( _raw_bits != INVALID_PATTERN_11 );
+                       ( _raw_bits != ( INVALID_PATTERN_11 & mask ) );
+        }
+
+        _trusted   = false;
+        _foreign   = false;
+        _corrected = false;
+#if defined(TPPM_EXTENDED_ADDRESS)
+        _paging    = false;
+        _pending   = false;
+#endif
+
+        if (_encoded)
+        {
+            Fields fields;
+
+            valid = unpack(_raw_bits, fields);
 
-            if (_encoded)
+            if (!valid)
             {
-                // To ensure an unencoded PPM frame is not validated we check for
-                // even parity on the encoder_id bits and for odd parity on the decoder_id
-                // and scan bis.
+                // Soft decision: a pulse a few us on the wrong side of a
+                // threshold is the most likely error
                 //
-                // In an unencoded PPM all the pulses shall have the same width
-                // thus the frame will fall in one of the following cases:
+                valid = retry(fields);
+            }
+
+            _corrected = fields.corrected;
+
+            if (valid)
+            {
+                _encoder_id = fields.encoder_id;
+
+                // It's really valid only if it comes from the coupled tx,
+                // if any, and...
                 //
-                // _raw_bits              : 0000000000000000000000
-                // _encoder_id            : 00000000 (expected even parity: 0)
-                // _decoder_id+_part_index: 00000000 (expected odd  parity: 1)
-                // _scan_index            : 0000     (expected odd  parity: 1)
-                // leader_id_even_parity  : 0 ->     parity match
-                // main_index_odd_parity  : 0 -> (E) parity does not match
-                // scan_index_odd_parity  : 0 -> (E) parity does not match
-                // ------------------------------------------------------
-                // _raw_bits              : 0101010101010101010101
-                // _encoder_id            : 00000000 (expected even parity: 0)
-                // _decoder_id+_part_index: 11111111 (expected odd  parity: 1)
-                // _scan_index            : 000      (expected odd  parity: 1)
-                // leader_id_even_parity  : 1 -> (E) parity does not match
-                // main_index_odd_parity  : 1 ->     parity match
-                // scan_index_odd_parity  : 1 ->     parity match
-                // ------------------------------------------------------
-                // _raw_bits              : 1010101010101010101010
-                // _encoder_id            : 11111111 (expected even parity: 0)
-                // _decoder_id+_part_index: 00000000 (expected odd  parity: 1)
-                // _scan_index            : 111      (expected odd  parity: 0)
-                // leader_id_even_parity  : 0 ->     parity match
-                // main_index_odd_parity  : 0 -> (E) parity does not match
-                // scan_index_odd_parity  : 0 ->     parity match
-                // ------------------------------------------------------
-                // _raw_bits              : 1111111111111111111111
-                // _encoder_id            : 11111111 (expected even parity: 0)
-                // _decoder_id+_part_index: 11111111 (expected odd  parity: 1)
-                // _scan_index            : 111      (expected odd  parity: 0)
-                // leader_id_even_parity  : 1 -> (E) parity does not match
-                // main_index_odd_parity  : 1 ->     parity match
-                // scan_index_odd_parity  : 1 -> (E) parity does not match
+                valid = (_coupled_id == 0) || (_encoder_id == _coupled_id);
+
+#if !defined(TPPM_EXTENDED_ADDRESS)
+                // A tag for me from another transmitter is foreign: a known
+                // one may take over the coupling (see adopt())
                 //
-                valid = !(BIT_VAL(_raw_bits, TX_ID_BIT_0          ) ^
-                          BIT_VAL(_raw_bits, TX_ID_BIT_1          ) ^
-                          BIT_VAL(_raw_bits, TX_ID_BIT_2          ) ^
-                          BIT_VAL(_raw_bits, TX_ID_BIT_3          ) ^
-                          BIT_VAL(_raw_bits, TX_ID_BIT_4          ) ^
-                          BIT_VAL(_raw_bits, TX_ID_BIT_5          ) ^
-                          BIT_VAL(_raw_bits, TX_ID_BIT_6          ) ^
-                          BIT_VAL(_raw_bits, TX_ID_BIT_7          ) ^
-                          BIT_VAL(_raw_bits, TX_ID_EVEN_PARITY_BIT))
-                        &&
-                        (BIT_VAL(_raw_bits, RX_ID_BIT_0           ) ^
-                         BIT_VAL(_raw_bits, RX_ID_BIT_1           ) ^
-                         BIT_VAL(_raw_bits, RX_ID_BIT_2           ) ^
-                         BIT_VAL(_raw_bits, RX_ID_BIT_3           ) ^
-                         BIT_VAL(_raw_bits, RX_SUB_ID_BIT_0       ) ^
-                         BIT_VAL(_raw_bits, RX_SUB_ID_BIT_1       ) ^
-                         BIT_VAL(_raw_bits, RX_SUB_ID_BIT_2       ) ^
-                         BIT_VAL(_raw_bits, RX_SUB_ID_BIT_3       ) ^
-                         BIT_VAL(_raw_bits, RX_ID_ODD_PARITY_BIT) )
-                        &&
-                        (BIT_VAL(_raw_bits, SCAN_BIT_0            ) ^
-                         BIT_VAL(_raw_bits, SCAN_BIT_1            ) ^
-                         BIT_VAL(_raw_bits, SCAN_BIT_2            ) ^
-                         BIT_VAL(_raw_bits, SCAN_ODD_PARITY_BIT)  );
-
-                if (valid)
+                if (!valid && (fields.decoder_id == _decoder_id))
                 {
-                    _encoder_id = (BIT_VAL(_raw_bits, TX_ID_BIT_0) << 0) |
-                                  (BIT_VAL(_raw_bits, TX_ID_BIT_1) << 1) |
-                                  (BIT_VAL(_raw_bits, TX_ID_BIT_2) << 2) |
-                                  (BIT_VAL(_raw_bits, TX_ID_BIT_3) << 3) |
-                                  (BIT_VAL(_raw_bits, TX_ID_BIT_4) << 4) |
-                                  (BIT_VAL(_raw_bits, TX_ID_BIT_5) << 5) |
-                                  (BIT_VAL(_raw_bits, TX_ID_BIT_6) << 6) |
-                                  (BIT_VAL(_raw_bits, TX_ID_BIT_7) << 7) ;
-
-                    // It's really valid only if it comes from the coupled tx,
-                    // if any, and...
-                    //
-                    valid = (_coupled_id == 0) || (_encoder_id == _coupled_id);
+                    _foreign      = true;
+                    _foreign_part = fields.part_index;
+                    _foreign_scan = fields.scan_index;
                 }
+#endif
+            }
 
-                _trusted = valid;
+            _trusted = valid;
 
-                if (valid)
-                {
-                    uint8_t decoder_id;
+#if defined(TPPM_EXTENDED_ADDRESS)
+            if (valid && (EXTENDED_PAGE_ID == fields.decoder_id))
+            {
+                // A page select frame is for all the decoders, none of them
+                // decodes its channels
+                //
+                page(fields.part_index, fields.scan_index);
 
-                    decoder_id = (BIT_VAL(_raw_bits, RX_ID_BIT_0) << 0) |
-                                 (BIT_VAL(_raw_bits, RX_ID_BIT_1) << 1) |
-                                 (BIT_VAL(_raw_bits, RX_ID_BIT_2) << 2) |
-                                 (BIT_VAL(_raw_bits, RX_ID_BIT_3) << 3) ;
+                valid = false;
+            }
+            else
+#endif
+            if (valid)
+            {
+                // ...it's really valid only if it is for me
+                //
+                valid = ( fields.decoder_id == _decoder_id );
 
-                    // ...it's really valid only if it is for me
-                    //
-                    valid = ( decoder_id == _decoder_id );
-                }
+#if defined(TPPM_EXTENDED_ADDRESS)
+                // ...and for my page
+                //
+                _pending = valid && !( _paged && ( _page_tx == _encoder_id ) );
 
-                if (valid)
-                {
-                    _part_index = (BIT_VAL(_raw_bits, RX_SUB_ID_BIT_0) << 0) |
-                                  (BIT_VAL(_raw_bits, RX_SUB_ID_BIT_1) << 1) |
-                                  (BIT_VAL(_raw_bits, RX_SUB_ID_BIT_2) << 2) |
-                                  (BIT_VAL(_raw_bits, RX_SUB_ID_BIT_3) << 3) ;
-
-                    _scan_index = (BIT_VAL(_raw_bits, SCAN_BIT_0) << 0) |
-                                  (BIT_VAL(_raw_bits, SCAN_BIT_2) << 1) |
-                                  (BIT_VAL(_raw_bits, SCAN_BIT_3) << 2) ;
-                }
+                valid = valid && !_pending && ( _page == _page_id );
+
+                // A page select is broken by any other frame
+                //
+                _page_next = 0;
+#endif
             }
 
-            _valid = valid;
+            if (valid)
+            {
+                _part_index = fields.part_index;
+                _scan_index = fields.scan_index;
+            }
+        }
+
+        _valid = valid;
+
+        // Only the widths of a good tag from the coupled transmitter move the
+        // symbol levels: not those of a plain PPM or noisy frame, nor those of
+        // a corrected tag, some of them on the wrong side of a threshold
+        //
+        if (_trusted && !_corrected)
+        {
+            _levels.apply();
         }
         else
         {
-            // too much fields -> invalidate the tag
+            _levels.discard();
+        }
+
+#if defined(TPPM_EXTENDED_ADDRESS)
+        if (!_trusted)
+        {
+            // A frame may have been lost, the page it selected with it
             //
-            _raw_bits = 0;
-            _valid    = false;
-            _trusted  = false;
-            _encoded  = false;
+            _page_next = 0;
+            _paged     = false;
+        }
+
+        if (_page_age < EXTENDED_PAGE_TIMEOUT)
+        {
+            ++_page_age;
+        }
+        else
+        {
+            _paged = false;
         }
+#endif
+
+#if defined(TPPM_TAG_8_LEVELS)
+        // The third bits of a corrected tag are not reliable: the pulse moved
+        // to another level lies in the wrong half of it
+        //
+        if (_valid && !_corrected && (_headroom >= HIGH_ORDER_MIN_MARGIN))
+        {
+            uint8_t data_bits = HIGH_ORDER_DATA_BITS(pulses);
+
+            _half_data = _half_bits & ((1 << data_bits) - 1);
+            _extended  = ((_half_bits >> data_bits) == high_order_check(_half_data | (_scan_index << data_bits)));
+        }
+#endif
+
+#if defined(TPPM_SYNC_SYMBOLS)
+        uint8_t check_bits = sync_check_bits(_layout);
+        uint8_t symbol     = _sync_data;
+
+        _sync_data = symbol >> check_bits;
+        _synced    = _valid
+                     &&
+                     (_sync_error <= SYNC_SYMBOL_MARGIN)
+                     &&
+                     ((symbol & ((1 << check_bits) - 1)) == sync_check(_layout, _scan_index));
+#endif
     }
 
-    inline void decode(TPPM::BasicChannels raw_channels_in   ,
-                       TPPM::ExtraChannels extra_channels_out,
-                       TPPM::OnOffChannels onoff_channels_out)
+#if defined(TPPM_SYNC_SYMBOLS)
+    // Returns the check bits of the sync gap symbol in the layout: 1 with the
+    // 6 on/off bits of a 10 channels scan slot, 3 with the nibble of an 8
+    // channels one
+    //
+    static inline uint8_t sync_check_bits(const Layout &layout)
+    {
+        return (LAYOUT_8CH == layout) ? (SYNC_SYMBOL_BITS - 4) : (SYNC_SYMBOL_BITS - (MUXED_CHANNLES << 1));
+    }
+
+    // Returns the check of the sync gap symbol: the low bits of the scan index
+    // of the frame. The symbols of a frame are then 2 (8 in the 8 channels
+    // layout) steps apart, a width fewer steps off is none of them, and the
+    // symbol of a frame with another scan index fails too.
+    //
+    static inline uint8_t sync_check(const Layout &layout, const uint8_t &scan_index)
+    {
+        return scan_index & ((1 << sync_check_bits(layout)) - 1);
+    }
+#endif
+
+    // Returns the check of the third bits data (see TPPM_TAG_8_LEVELS): a
+    // CRC-5, not null for null data
+    //
+    static inline uint8_t high_order_check(const uint16_t &data)
+    {
+        uint8_t crc = (1 << HIGH_ORDER_CHECK_BITS) - 1;
+
+        for (uint8_t b=0; b<16; ++b)
+        {
+            uint8_t feedback = ((crc >> (HIGH_ORDER_CHECK_BITS - 1)) ^ (data >> b)) & 0x01;
+
+            crc = (crc << 1) & ((1 << HIGH_ORDER_CHECK_BITS) - 1);
+
+            if (feedback)
+            {
+                crc ^= HIGH_ORDER_CHECK_POLY;
+            }
+        }
+
+        return crc;
+    }
+
+    // Returns the slots refreshed by the frame as a bit mask (see
+    // REFRESH_SLOTS): the scan index's extra and on/off ones, and the on/off
+    // HIGH_ORDER_SLOT() and SYNC_SLOT() when they are carried
+    //
+    inline uint16_t refreshed_slots()
+    {
+        uint16_t slots = (1 << (_scan_index & (ONOFF_SCAN_SLOTS - 1))) | (1 << EXTRA_REFRESH_SLOT(_scan_index));
+
+#if defined(TPPM_TAG_8_LEVELS)
+        if (_extended)
+        {
+            slots |= (1 << HIGH_ORDER_SLOT(_scan_index));
+        }
+#endif
+
+#if defined(TPPM_SYNC_SYMBOLS)
+        if (_synced)
+        {
+            slots |= (1 << SYNC_SLOT(_scan_index));
+        }
+#endif
+
+        return slots;
+    }
+
+    inline void decode(const TPPM::ChannelWord *raw_channels_in   ,
+                       TPPM::ChannelWord       *extra_channels_out,
+                       uint8_t                 *onoff_channels_out)
     {
         if ((NULL == raw_channels_in)
             ||
@@ -277,9 +682,43 @@ public:
                 // |  6 | extra channels ||  8  |  9 | 10 | 11 |  8 |  9 | 10 | 11 |
                 // +----+----------------++-----+----+----+----+----+----+----+----+
                 //
-                extra_channels_out[(_scan_index & 3) | (c << 2)] = raw_channels_in[c+FIRST_EXTRA_CHANNEL];
+                TPPM::set_channel(extra_channels_out,
+                                  (_scan_index & 3) | (c << 2),
+                                  TPPM::get_channel(raw_channels_in, c+FIRST_EXTRA_CHANNEL));
             }
 
+            if ((NULL != onoff_channels_out) && (LAYOUT_8CH == _layout))
+            {
+                // On/Off channels nibble addressed by the superimposed tag's
+                // scan index (doc/Codes8ch.txt):
+                //
+                // +----+-----------------++---------------------------------------------------------------+
+                // |    |                 ||                           scan index                          |
+                // | CH | Function        ||   0   |   1   |   2   |   3   |   4   |   5   |   6   |   7   |
+                // +----+-----------------++-------+-------+-------+-------+-------+-------+-------+-------+
+                // |  8 | on/off channels ||  0- 3 |  4- 7 |  8-11 | 12-15 | 16-19 | 20-23 | 24-27 | 28-31 |
+                // +----+-----------------++-------+-------+-------+-------+-------+-------+-------+-------+
+                //
+                if (0 == c)
+                {
+                    uint16_t channel_val = TPPM::get_channel(raw_channels_in, FIRST_ONOFF_CHANNEL);
+                    uint8_t  nibble      = 0;
+
+                    if (channel_val > MIN_CHANNEL_WIDTH)
+                    {
+                        uint16_t level = (channel_val - MIN_CHANNEL_WIDTH) / ONOFF_NIBBLE_STEP;
+
+                        nibble = (level > 0x0f) ? 0x0f : level;
+                    }
+
+                    uint8_t byte_index = ONOFF_NIBBLE_BYTE (_scan_index);
+                    uint8_t bit_index  = ONOFF_NIBBLE_SHIFT(_scan_index);
+
+                    onoff_channels_out[byte_index] &= ~(0x0f   << bit_index);
+                    onoff_channels_out[byte_index] |=  (nibble << bit_index);
+                }
+            }
+            else
             if (NULL != onoff_channels_out)
             {
                 // On/Off channels addressed by the superimposed tag's scan index:
@@ -293,7 +732,7 @@ public:
                 // |  9 | on/off channels || 32 / 33 | 34 / 35 | 36 / 37 | 38 / 39 | 40 / 41 | 42 / 43 | 44 / 45 | 46 / 47 |
                 // +----+-----------------++---------+---------+---------+---------+---------+---------+---------+---------+
                 //
-                uint8_t &channel_val = raw_channels_in[c+FIRST_ONOFF_CHANNEL];
+                uint16_t channel_val = TPPM::get_channel(raw_channels_in, c+FIRST_ONOFF_CHANNEL);
 
                 // On/Off channels bits addressed by the superimposed tag's scan index:
                 //
@@ -319,22 +758,22 @@ public:
                 // |  9 | on/off channels bytes || 4 | 4 | 4 | 4 | 5 | 5 | 5 | 5 |
                 // +----+-----------------------++---+---+---+---+---+---+---+---+
                 //
-                uint8_t byte_index = (c << 2) + ((_scan_index & 4) >> 3);
+                uint8_t byte_index = ONOFF_SCAN_BYTE(c, _scan_index);
 
                 // clear the bits
                 //
-                onoff_channels_out[byte_index] &= ~(0x11 << bit_index);
+                onoff_channels_out[byte_index] &= ~(0x03 << bit_index);
 
                 // set the bits
                 //
                 if (channel_val >= ONOFF_THRESHOLD_10)
                 {
-                    onoff_channels_out[byte_index] |= (0x11 << bit_index);
+                    onoff_channels_out[byte_index] |= (0x03 << bit_index);
                 }
                 else
                 if (channel_val >= ONOFF_THRESHOLD_01)
                 {
-                    onoff_channels_out[byte_index] |= (0x10 << bit_index);
+                    onoff_channels_out[byte_index] |= (0x02 << bit_index);
                 }
                 else
                 if (channel_val >= ONOFF_THRESHOLD_00)
@@ -343,16 +782,79 @@ public:
                 }
             }
         }
+
+#if defined(TPPM_TAG_8_LEVELS)
+        if ((NULL != onoff_channels_out) && _extended)
+        {
+            // The third bits carry the on/off channels of the second scan slot
+            //
+            set_onoff_slot(onoff_channels_out, HIGH_ORDER_SLOT(_scan_index), _half_data);
+        }
+#endif
+
+#if defined(TPPM_SYNC_SYMBOLS)
+        if ((NULL != onoff_channels_out) && _synced)
+        {
+            // The sync gap symbol carries the on/off channels of a further
+            // scan slot
+            //
+            set_onoff_slot(onoff_channels_out, SYNC_SLOT(_scan_index), _sync_data);
+        }
+#endif
     }
 
     inline void connect()
     {
-        if (_valid)
+        if (_valid || is_paging())
+        {
+            _coupled_id = _encoder_id;
+        }
+    }
+
+    // Couple the transmitter of the foreign frame just ended, the frame is
+    // then valid (see TPPMSum::add_transmitter())
+    //
+    inline void adopt()
+    {
+        if (_foreign)
         {
             _coupled_id = _encoder_id;
+            _part_index = _foreign_part;
+            _scan_index = _foreign_scan;
+            _valid      = true;
+            _trusted    = true;
+            _foreign    = false;
         }
     }
 
+    // Returns the encoder id of the coupled transmitter, 0 if none
+    //
+    inline uint8_t coupled_id()
+    {
+        return _coupled_id;
+    }
+
+    // Couple a transmitter known in advance (see TPPMSum::warm_start())
+    //
+    inline void couple(const uint8_t &encoder_id)
+    {
+        _coupled_id = encoder_id;
+    }
+
+    // Returns the worst symbol margin since the last restart(), in Timer1 ticks
+    //
+    inline uint16_t symbol_margin()
+    {
+        return _margin;
+    }
+
+    // Start collecting a new frame's statistics
+    //
+    inline void restart()
+    {
+        _margin = 0xffff;
+    }
+
     inline bool is_valid()
     {
         return _valid;
@@ -368,6 +870,67 @@ public:
         return _encoded;
     }
 
+    // Returns true if the frame was for the decoder id from another
+    // transmitter than the coupled one (not with TPPM_EXTENDED_ADDRESS, the
+    // page selects are bound to the coupled transmitter)
+    //
+    inline bool is_foreign()
+    {
+        return _foreign;
+    }
+
+    // Returns true if the third bits of the 8 levels symbols were decoded
+    // (see TPPM_TAG_8_LEVELS)
+    //
+    inline bool is_extended()
+    {
+#if defined(TPPM_TAG_8_LEVELS)
+        return _extended;
+#else
+        return false;
+#endif
+    }
+
+    // Returns true if the frame was a page select (see TPPM_EXTENDED_ADDRESS):
+    // trusted, addressed to all the decoders, carrying no channels
+    //
+    inline bool is_paging()
+    {
+#if defined(TPPM_EXTENDED_ADDRESS)
+        return _paging;
+#else
+        return false;
+#endif
+    }
+
+    // Returns true if the frame was addressed to the decoder id while no page
+    // is selected (see TPPM_EXTENDED_ADDRESS): it is for this decoder or for
+    // another one with the same id in another page, the next page select tells
+    //
+    inline bool is_pending()
+    {
+#if defined(TPPM_EXTENDED_ADDRESS)
+        return _pending;
+#else
+        return false;
+#endif
+    }
+
+    // Returns true if the tag was valid only after correcting an error
+    // (see TPPM_TAG_FEC)
+    //
+    inline bool is_corrected()
+    {
+        return _corrected;
+    }
+
+    // Returns the learned width of the symbol level
+    //
+    inline uint16_t level(const uint8_t &symbol)
+    {
+        return _levels.level(symbol);
+    }
+
     inline uint8_t encoder_id()
     {
         return _encoder_id;
@@ -384,7 +947,344 @@ public:
     }
 
 private:
-    uint32_t _raw_bits  ;
+    // The fields carried by the tag bits
+    //
+    struct Fields
+    {
+        uint8_t encoder_id;
+        uint8_t decoder_id;
+        uint8_t part_index;
+        uint8_t scan_index;
+        bool    corrected ; // an error has been corrected to get them
+    };
+
+    // Check the tag symbols levels and extract their fields, returns false if
+    // the check fails
+    //
+    inline bool unpack(const uint32_t &levels, Fields &fields)
+    {
+        fields.corrected = false;
+
+        if (LAYOUT_8CH == _layout)
+        {
+            return unpack_8ch(levels, fields);
+        }
+
+        uint32_t bits = 0;
+
+        for (uint8_t p=0; p<(LAYOUT_10CH_CHANNELS + 1); ++p)
+        {
+            bits |= (uint32_t)SYMBOL_BITS((levels >> (p << 1)) & 0x03) << (p << 1);
+        }
+
+#if defined(TPPM_TAG_FEC)
+        // Correct a single bit error: a pulse read one level off
+        //
+        uint16_t            data;
+        TPPMTagCode::Result result = TPPMTagCode::decode(bits, data);
+
+        // The encoder id 0 is never transmitted: an unencoded PPM frame
+        // with a noisy pulse is corrected to the all zeros code
+        //
+        if ((TPPMTagCode::FAILED == result) || (0 == TAG_TX_ID(data)))
+        {
+            return false;
+        }
+
+        fields.encoder_id = TAG_TX_ID (data);
+        fields.decoder_id = TAG_RX_ID (data);
+        fields.part_index = TAG_SUB_ID(data);
+        fields.scan_index = TAG_SCAN  (data);
+        fields.corrected  = (TPPMTagCode::CORRECTED == result);
+
+        return true;
+#else
+        // To ensure an unencoded PPM frame is not validated we check for
+        // even parity on the encoder_id bits and for odd parity on the decoder_id
+        // and scan bis.
+        //
+        // In an unencoded PPM all the pulses shall have the same width
+        // thus the frame will fall in one of the following cases:
+        //
+        // _raw_bits              : 0000000000000000000000
+        // _encoder_id            : 00000000 (expected even parity: 0)
+        // _decoder_id+_part_index: 00000000 (expected odd  parity: 1)
+        // _scan_index            : 0000     (expected odd  parity: 1)
+        // leader_id_even_parity  : 0 ->     parity match
+        // main_index_odd_parity  : 0 -> (E) parity does not match
+        // scan_index_odd_parity  : 0 -> (E) parity does not match
+        // ------------------------------------------------------
+        // _raw_bits              : 0101010101010101010101
+        // _encoder_id            : 00000000 (expected even parity: 0)
+        // _decoder_id+_part_index: 11111111 (expected odd  parity: 1)
+        // _scan_index            : 000      (expected odd  parity: 1)
+        // leader_id_even_parity  : 1 -> (E) parity does not match
+        // main_index_odd_parity  : 1 ->     parity match
+        // scan_index_odd_parity  : 1 ->     parity match
+        // ------------------------------------------------------
+        // _raw_bits              : 1010101010101010101010
+        // _encoder_id            : 11111111 (expected even parity: 0)
+        // _decoder_id+_part_index: 00000000 (expected odd  parity: 1)
+        // _scan_index            : 111      (expected odd  parity: 0)
+        // leader_id_even_parity  : 0 ->     parity match
+        // main_index_odd_parity  : 0 -> (E) parity does not match
+        // scan_index_odd_parity  : 0 ->     parity match
+        // ------------------------------------------------------
+        // _raw_bits              : 1111111111111111111111
+        // _encoder_id            : 11111111 (expected even parity: 0)
+        // _decoder_id+_part_index: 11111111 (expected odd  parity: 1)
+        // _scan_index            : 111      (expected odd  parity: 0)
+        // leader_id_even_parity  : 1 -> (E) parity does not match
+        // main_index_odd_parity  : 1 ->     parity match
+        // scan_index_odd_parity  : 1 -> (E) parity does not match
+        //
+        bool valid = !(BIT_VAL(bits, TX_ID_BIT_0          ) ^
+                       BIT_VAL(bits, TX_ID_BIT_1          ) ^
+                       BIT_VAL(bits, TX_ID_BIT_2          ) ^
+                       BIT_VAL(bits, TX_ID_BIT_3          ) ^
+                       BIT_VAL(bits, TX_ID_BIT_4          ) ^
+                       BIT_VAL(bits, TX_ID_BIT_5          ) ^
+                       BIT_VAL(bits, TX_ID_BIT_6          ) ^
+                       BIT_VAL(bits, TX_ID_BIT_7          ) ^
+                       BIT_VAL(bits, TX_ID_EVEN_PARITY_BIT))
+                     &&
+                     (BIT_VAL(bits, RX_ID_BIT_0           ) ^
+                      BIT_VAL(bits, RX_ID_BIT_1           ) ^
+                      BIT_VAL(bits, RX_ID_BIT_2           ) ^
+                      BIT_VAL(bits, RX_ID_BIT_3           ) ^
+                      BIT_VAL(bits, RX_SUB_ID_BIT_0       ) ^
+                      BIT_VAL(bits, RX_SUB_ID_BIT_1       ) ^
+                      BIT_VAL(bits, RX_SUB_ID_BIT_2       ) ^
+                      BIT_VAL(bits, RX_SUB_ID_BIT_3       ) ^
+                      BIT_VAL(bits, RX_ID_ODD_PARITY_BIT) )
+                     &&
+                     (BIT_VAL(bits, SCAN_BIT_0            ) ^
+                      BIT_VAL(bits, SCAN_BIT_1            ) ^
+                      BIT_VAL(bits, SCAN_BIT_2            ) ^
+                      BIT_VAL(bits, SCAN_ODD_PARITY_BIT)  );
+
+        if (!valid)
+        {
+            return false;
+        }
+
+        fields.encoder_id = (BIT_VAL(bits, TX_ID_BIT_0) << 0) |
+                            (BIT_VAL(bits, TX_ID_BIT_1) << 1) |
+                            (BIT_VAL(bits, TX_ID_BIT_2) << 2) |
+                            (BIT_VAL(bits, TX_ID_BIT_3) << 3) |
+                            (BIT_VAL(bits, TX_ID_BIT_4) << 4) |
+                            (BIT_VAL(bits, TX_ID_BIT_5) << 5) |
+                            (BIT_VAL(bits, TX_ID_BIT_6) << 6) |
+                            (BIT_VAL(bits, TX_ID_BIT_7) << 7) ;
+
+        fields.decoder_id = (BIT_VAL(bits, RX_ID_BIT_0) << 0) |
+                            (BIT_VAL(bits, RX_ID_BIT_1) << 1) |
+                            (BIT_VAL(bits, RX_ID_BIT_2) << 2) |
+                            (BIT_VAL(bits, RX_ID_BIT_3) << 3) ;
+
+        fields.part_index = (BIT_VAL(bits, RX_SUB_ID_BIT_0) << 0) |
+                            (BIT_VAL(bits, RX_SUB_ID_BIT_1) << 1) |
+                            (BIT_VAL(bits, RX_SUB_ID_BIT_2) << 2) |
+                            (BIT_VAL(bits, RX_SUB_ID_BIT_3) << 3) ;
+
+        fields.scan_index = (BIT_VAL(bits, SCAN_BIT_0) << 0) |
+                            (BIT_VAL(bits, SCAN_BIT_1) << 1) |
+                            (BIT_VAL(bits, SCAN_BIT_2) << 2) ;
+
+        return true;
+#endif
+    }
+
+    // Check the 8 channels layout's tag (doc/Codes8ch.txt): always parity
+    // checked, even parity on the bit 0 of the pulses and odd parity on their
+    // bit 1. The encoder id 0 is never transmitted: it rejects the unencoded
+    // PPM frames the parities alone would accept.
+    //
+    inline bool unpack_8ch(const uint32_t &bits, Fields &fields)
+    {
+        uint8_t even = 0;
+        uint8_t odd  = 0;
+
+        for (uint8_t p=0; p<(LAYOUT_8CH_CHANNELS + 1); ++p)
+        {
+            even ^= BIT_VAL(bits, (p << 1)    );
+            odd  ^= BIT_VAL(bits, (p << 1) + 1);
+        }
+
+        fields.encoder_id = (BIT_VAL(bits, TAG8_TX_ID_BIT_0) << 0) |
+                            (BIT_VAL(bits, TAG8_TX_ID_BIT_1) << 1) |
+                            (BIT_VAL(bits, TAG8_TX_ID_BIT_2) << 2) |
+                            (BIT_VAL(bits, TAG8_TX_ID_BIT_3) << 3) |
+                            (BIT_VAL(bits, TAG8_TX_ID_BIT_4) << 4) ;
+
+        if ((0 != even) || (1 != odd) || (0 == fields.encoder_id))
+        {
+            return false;
+        }
+
+        fields.decoder_id = (BIT_VAL(bits, TAG8_RX_ID_BIT_0) << 0) |
+                            (BIT_VAL(bits, TAG8_RX_ID_BIT_1) << 1) |
+                            (BIT_VAL(bits, TAG8_RX_ID_BIT_2) << 2) |
+                            (BIT_VAL(bits, TAG8_RX_ID_BIT_3) << 3) ;
+
+        fields.part_index = (BIT_VAL(bits, TAG8_RX_SUB_ID_BIT_0) << 0) |
+                            (BIT_VAL(bits, TAG8_RX_SUB_ID_BIT_1) << 1) |
+                            (BIT_VAL(bits, TAG8_RX_SUB_ID_BIT_2) << 2) |
+                            (BIT_VAL(bits, TAG8_RX_SUB_ID_BIT_3) << 3) ;
+
+        fields.scan_index = (BIT_VAL(bits, TAG8_SCAN_BIT_0) << 0) |
+                            (BIT_VAL(bits, TAG8_SCAN_BIT_1) << 1) |
+                            (BIT_VAL(bits, TAG8_SCAN_BIT_2) << 2) ;
+
+        return true;
+    }
+
+#if defined(TPPM_EXTENDED_ADDRESS)
+    // A page select frame: its nibble is kept if it follows the previous one
+    // in the sequence, the page is selected once all of them are received
+    //
+    inline void page(const uint8_t &nibble, const uint8_t &sequence)
+    {
+        _paging = true;
+
+        if (_page_tx != _encoder_id)
+        {
+            // Another transmitter: its page select starts over
+            //
+            _page_tx   = _encoder_id;
+            _page_next = 0;
+            _paged     = false;
+        }
+
+        if (0 == sequence)
+        {
+            // A new page select, the frames are no more addressed to the
+            // previous page
+            //
+            _page      = 0;
+            _page_next = 0;
+            _paged     = false;
+        }
+
+        if (sequence != _page_next)
+        {
+            // Out of sequence: wait for the next page select
+            //
+            _page_next = 0;
+            _paged     = false;
+
+            return;
+        }
+
+        _page |= (nibble & 0x0f) << (sequence << 2);
+
+        if (EXTENDED_PAGE_FRAMES == ++_page_next)
+        {
+            _page_next = 0;
+            _page_age  = 0;
+            _paged     = true;
+        }
+    }
+#endif
+
+    // Set the on/off channels of a scan slot, from their bits laid out as the
+    // channels carry them: a nibble in the 8 channels layout, a pair for each
+    // multiplexed channel in the 10 channels one
+    //
+    inline void set_onoff_slot(uint8_t *onoff_channels_out, const uint8_t &slot, const uint8_t &bits)
+    {
+        if (LAYOUT_8CH == _layout)
+        {
+            onoff_channels_out[ONOFF_NIBBLE_BYTE(slot)] &= ~(0x0f << ONOFF_NIBBLE_SHIFT(slot));
+            onoff_channels_out[ONOFF_NIBBLE_BYTE(slot)] |=  ((bits & 0x0f) << ONOFF_NIBBLE_SHIFT(slot));
+        }
+        else
+        {
+            for (uint8_t c=0; c<MUXED_CHANNLES; ++c)
+            {
+                uint8_t byte_index = ONOFF_SCAN_BYTE(c, slot);
+                uint8_t bit_index  = ((slot & 3) << 1);
+
+                onoff_channels_out[byte_index] &= ~(0x03 << bit_index);
+                onoff_channels_out[byte_index] |=  (((bits >> (c << 1)) & 0x03) << bit_index);
+            }
+        }
+    }
+
+    // Retry the check with the least confident symbols moved to their
+    // neighbour level: the weakest, the second weakest, then both
+    //
+    inline bool retry(Fields &fields)
+    {
+        for (uint8_t trial=1; trial<(1 << SOFT_DECISION_SYMBOLS); ++trial)
+        {
+            uint32_t levels = _raw_bits;
+            bool     fit    = true;
+
+            for (uint8_t w=0; w<SOFT_DECISION_SYMBOLS; ++w)
+            {
+                if (trial & (1 << w))
+                {
+                    if (_weak[w].margin > SOFT_DECISION_MARGIN)
+                    {
+                        // Too confident to be wrong
+                        //
+                        fit = false;
+
+                        break;
+                    }
+
+                    uint8_t bit_index = (_weak[w].pulse << 1);
+
+                    levels &= ~((uint32_t)0x03 << bit_index);
+                    levels |=  ((uint32_t)_weak[w].neighbour << bit_index);
+                }
+            }
+
+            if (fit && unpack(levels, fields))
+            {
+                fields.corrected = true;
+
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Keep the least confident symbols of the frame, the weakest first
+    //
+    inline void weak_symbol(const uint8_t &pulse, const uint16_t &margin, const uint8_t &neighbour)
+    {
+        for (uint8_t w=0; w<SOFT_DECISION_SYMBOLS; ++w)
+        {
+            if (margin < _weak[w].margin)
+            {
+                for (uint8_t m=SOFT_DECISION_SYMBOLS-1; m>w; --m)
+                {
+                    _weak[m] = _weak[m - 1];
+                }
+
+                _weak[w].pulse     = pulse;
+                _weak[w].margin    = margin;
+                _weak[w].neighbour = neighbour;
+
+                break;
+            }
+        }
+    }
+
+    struct WeakSymbol
+    {
+        uint8_t  pulse    ;
+        uint16_t margin   ; // from the nearest inner threshold
+        uint8_t  neighbour; // the level across it
+    };
+
+    Layout   _layout    ;
+    uint8_t  _pulses    ; // captured in the frame
+    bool     _symbols   ; // all of them symbols so far
+    uint32_t _raw_bits  ; // the symbol levels, 2 bits per pulse
     uint8_t  _coupled_id;
     uint8_t  _encoder_id;
     uint8_t  _decoder_id;
@@ -392,8 +1292,44 @@ private:
     uint8_t  _scan_index;
     bool     _valid     ;
     bool     _trusted   ;
+    bool     _foreign   ; // for me, from another transmitter
     bool     _encoded   ;
+    bool     _corrected ;
+    uint16_t _margin    ;
+    uint8_t  _foreign_part; // the foreign tag's part and scan indexes
+    uint8_t  _foreign_scan;
+
+#if defined(TPPM_TAG_8_LEVELS)
+    bool     _extended  ;
+    uint16_t _half_bits ; // the third bits, 1 per pulse
+    uint16_t _half_data ; // the third bits, checked
+    uint16_t _headroom  ; // worst distance from the middle of the levels
+#endif
+
+#if defined(TPPM_SYNC_SYMBOLS)
+    bool     _synced    ;
+    uint8_t  _sync_data ; // the sync gap symbol, its data once checked
+    uint16_t _sync_error; // its distance from the symbol step
+#endif
+
+#if defined(TPPM_EXTENDED_ADDRESS)
+    uint8_t  _page_id   ; // the page of the decoder id
+    uint8_t  _page_tx   ; // the encoder id of the transmitter selecting _page
+    uint8_t  _page      ; // the page selected by the transmitter
+    uint8_t  _page_next ; // the sequence number of the next page select frame
+    uint8_t  _page_age  ; // frames since the last page select
+    bool     _paged     ; // _page is complete and current
+    bool     _paging    ; // the frame is a page select
+    bool     _pending   ; // the frame is for the decoder id, no page is selected
+#endif
 
+    TPPMLevels _levels;
+    WeakSymbol _weak[SOFT_DECISION_SYMBOLS];
+
+public:
+    // Tag bits positions: the n-th pulse (from 0) carries bits 2n (bit 0) and
+    // 2n+1 (bit 1) as documented in doc/Codes10ch.txt
+    //
     enum CodeBits
     {
         TX_ID_BIT_0       = 0,
@@ -419,6 +1355,31 @@ private:
         SCAN_BIT_2           ,
         SCAN_ODD_PARITY_BIT
     };
+
+    // Tag bits positions of the 8 channels layout, as documented in
+    // doc/Codes8ch.txt
+    //
+    enum CodeBits8ch
+    {
+        TAG8_TX_ID_BIT_0      = 0,
+        TAG8_RX_ID_BIT_0         ,
+        TAG8_TX_ID_BIT_1         ,
+        TAG8_RX_ID_BIT_1         ,
+        TAG8_TX_ID_BIT_2         ,
+        TAG8_RX_ID_BIT_2         ,
+        TAG8_TX_ID_BIT_3         ,
+        TAG8_RX_ID_BIT_3         ,
+        TAG8_TX_ID_BIT_4         ,
+        TAG8_RX_SUB_ID_BIT_0     ,
+        TAG8_SCAN_BIT_0          ,
+        TAG8_RX_SUB_ID_BIT_1     ,
+        TAG8_SCAN_BIT_1          ,
+        TAG8_RX_SUB_ID_BIT_2     ,
+        TAG8_SCAN_BIT_2          ,
+        TAG8_RX_SUB_ID_BIT_3     ,
+        TAG8_EVEN_PARITY_BIT     , // over the bits 0
+        TAG8_ODD_PARITY_BIT        // over the bits 1
+    };
 };
 
 #endif // __TPPM_TAG_H__
@@ -0,0 +1,165 @@
+#if !defined(__TPPM_TAG_CODE_H__)
+#define __TPPM_TAG_CODE_H__
+
+#include "TPPMCfg.h"
+
+// Extended Hamming (22,16) code of the superimposed tag (see TPPM_TAG_FEC).
+//
+// The 22 tag bits are the code positions: bit 0 is the overall parity, bits
+// 1, 2, 4, 8 and 16 the Hamming parities, the other 16 bits the data:
+//
+//   +------------+----------------------------------------------------------+
+//   | data bits  |  0  1  2  3  4 |  5  6  7  8 |  9 10 11 12 | 13 14 15    |
+//   +------------+----------------+-------------+-------------+-------------+
+//   | field      |  encoder id    |  decoder id |  part index |  scan index |
+//   +------------+----------------+-------------+-------------+-------------+
+//
+// The symbols are Gray coded (see SYMBOL_BITS), so a pulse read one level off
+// flips a single bit: it is corrected, two of them are detected.
+//
+#define TAG_CODE_BITS           22
+#define TAG_DATA_BITS           16
+
+#define TAG_TX_ID_BITS          5
+#define TAG_RX_ID_BITS          4
+#define TAG_SUB_ID_BITS         4
+#define TAG_SCAN_BITS           3
+
+#define TAG_TX_ID(data)         ( ( (data)       ) & 0x1f )
+#define TAG_RX_ID(data)         ( ( (data) >>  5 ) & 0x0f )
+#define TAG_SUB_ID(data)        ( ( (data) >>  9 ) & 0x0f )
+#define TAG_SCAN(data)          ( ( (data) >> 13 ) & 0x07 )
+
+#define TAG_DATA(tx,rx,sub,scan) ( ( (uint16_t)( (tx)   & 0x1f )       ) | \
+                                   ( (uint16_t)( (rx)   & 0x0f ) <<  5 ) | \
+                                   ( (uint16_t)( (sub)  & 0x0f ) <<  9 ) | \
+                                   ( (uint16_t)( (scan) & 0x07 ) << 13 ) )
+
+class TPPMTagCode
+{
+public:
+    enum Result
+    {
+        CLEAN    , // no errors
+        CORRECTED, // a single bit error corrected
+        FAILED     // two or more bit errors
+    };
+
+    // Returns the tag bits of the data
+    //
+    static inline uint32_t encode(const uint16_t &data)
+    {
+        uint32_t code = 0;
+
+        for (uint8_t d=0; d<TAG_DATA_BITS; ++d)
+        {
+            if ((data >> d) & 0x01)
+            {
+                code |= (uint32_t)1 << position(d);
+            }
+        }
+
+        uint8_t syndrome = syndrome_of(code);
+
+        for (uint8_t p=1; p<TAG_CODE_BITS; p<<=1)
+        {
+            if (syndrome & p)
+            {
+                code |= (uint32_t)1 << p;
+            }
+        }
+
+        if (parity_of(code))
+        {
+            code |= 0x01;
+        }
+
+        return code;
+    }
+
+    // Correct the tag bits and extract their data
+    //
+    static inline Result decode(uint32_t code, uint16_t &data)
+    {
+        uint8_t syndrome = syndrome_of(code);
+        Result  result   = CLEAN;
+
+        if (parity_of(code))
+        {
+            // An odd number of errors: a single one at the syndrome position
+            // (0: the overall parity bit itself)
+            //
+            if (syndrome >= TAG_CODE_BITS)
+            {
+                return FAILED;
+            }
+
+            code   ^= (uint32_t)1 << syndrome;
+            result  = CORRECTED;
+        }
+        else
+        if (0 != syndrome)
+        {
+            // An even number of errors
+            //
+            return FAILED;
+        }
+
+        data = 0;
+
+        for (uint8_t d=0; d<TAG_DATA_BITS; ++d)
+        {
+            if ((code >> position(d)) & 0x01)
+            {
+                data |= (uint16_t)1 << d;
+            }
+        }
+
+        return result;
+    }
+
+private:
+    // Code position of the data bit: the positions not power of 2
+    //
+    static inline uint8_t position(const uint8_t &data_bit)
+    {
+        static const uint8_t positions[TAG_DATA_BITS] =
+        {
+            3, 5, 6, 7, 9, 10, 11, 12, 13, 14, 15, 17, 18, 19, 20, 21
+        };
+
+        return positions[data_bit];
+    }
+
+    // XOR of the positions of the bits set
+    //
+    static inline uint8_t syndrome_of(const uint32_t &code)
+    {
+        uint8_t syndrome = 0;
+
+        for (uint8_t p=1; p<TAG_CODE_BITS; ++p)
+        {
+            if ((code >> p) & 0x01)
+            {
+                syndrome ^= p;
+            }
+        }
+
+        return syndrome;
+    }
+
+    static inline uint8_t parity_of(uint32_t code)
+    {
+        uint8_t parity = 0;
+
+        while (code)
+        {
+            parity ^= 1;
+            code   &= code - 1;
+        }
+
+        return parity;
+    }
+};
+
+#endif // __TPPM_TAG_CODE_H__
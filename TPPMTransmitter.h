@@ -0,0 +1,196 @@
+#if !defined(__TPPM_TRANSMITTER_H__)
+#define __TPPM_TRANSMITTER_H__
+
+#include "TPPMFingerprint.h"
+
+// The transmitter driving the outputs is lost when TRANSMITTER_LOST_FRAMES
+// frames in a row are not its own: the next frame of another known
+// transmitter takes over
+//
+#define TRANSMITTER_LOST_FRAMES   2
+
+#define NO_TRANSMITTER            0xff
+
+namespace TPPM
+{
+    // Which known transmitter drives the outputs (see
+    // TPPMSum::select_transmitters())
+    //
+    enum Selection
+    {
+        SELECT_PRIORITY = 0, // the alive one with the lowest priority value
+        SELECT_RECENT      , // the last one come alive
+        SELECT_EXPLICIT      // the one selected by the application, no failover
+    };
+};
+
+// A tagged transmitter known to the decoder, identified by its encoder id:
+// its fingerprint, its fail safe frame and the channels of its last frame,
+// kept up to date from its frames while another transmitter drives the
+// outputs, so that it takes over on its next frame without being learned.
+//
+class TPPMTransmitter
+{
+public:
+    TPPMTransmitter()
+    {
+        reset();
+    }
+
+    // Forget the transmitter, the entry is free
+    //
+    inline void reset()
+    {
+        _encoder_id    = 0;
+        _priority      = 0;
+        _good_frames   = 0;
+        _fail_safe_set = false;
+        _heard         = false;
+        _stamp         = 0;
+
+        _fingerprint.reset();
+    }
+
+    // Know the transmitter with the encoder id, the lowest priority value
+    // first (see TPPM::SELECT_PRIORITY)
+    //
+    inline void add(const uint8_t &encoder_id, const uint8_t &priority)
+    {
+        if (encoder_id != _encoder_id)
+        {
+            reset();
+        }
+
+        _encoder_id = encoder_id;
+        _priority   = priority;
+    }
+
+    // A frame of the transmitter, not driving the outputs, has been captured:
+    // returns true if it matches the fingerprint, its channels are then kept.
+    // A mismatching frame restarts the learning.
+    //
+    inline bool frame(const uint8_t           &channels_count,
+                      const uint16_t          &frame_period  ,
+                      const uint16_t          &sync_width    ,
+                      const TPPM::ChannelWord *channels      ,
+                      const TPPM::FrameStamp  &now           )
+    {
+        if (!_fingerprint.frame(channels_count, frame_period, sync_width, true))
+        {
+            _fingerprint.reset();
+
+            _good_frames = 0;
+
+            return false;
+        }
+
+        for (uint8_t w=0; w < CHANNEL_WORDS(MAX_CHANNELS); w++)
+        {
+            _channels[w] = channels[w];
+        }
+
+        if (_good_frames < 0xff)
+        {
+            ++_good_frames;
+        }
+
+        _heard = true;
+        _stamp = now;
+
+        return true;
+    }
+
+    // A frame of the transmitter has been captured while it drives the outputs
+    //
+    inline void seen(const TPPM::FrameStamp &now)
+    {
+        _heard = true;
+        _stamp = now;
+    }
+
+    // Keep the lock on the transmitter when another one takes over the outputs
+    //
+    inline void save(const TPPMFingerprint   &fingerprint  ,
+                     const TPPM::ChannelWord *fail_safe    ,
+                     const bool              &fail_safe_set,
+                     const TPPM::ChannelWord *channels     )
+    {
+        _fingerprint   = fingerprint;
+        _fail_safe_set = fail_safe_set;
+
+        for (uint8_t w=0; w < CHANNEL_WORDS(MAX_CHANNELS); w++)
+        {
+            _fail_safe[w] = fail_safe[w];
+            _channels [w] = channels [w];
+        }
+    }
+
+    // Its last frame channels become its fail safe ones
+    //
+    inline void learn_fail_safe()
+    {
+        for (uint8_t w=0; w < CHANNEL_WORDS(MAX_CHANNELS); w++)
+        {
+            _fail_safe[w] = _channels[w];
+        }
+
+        _fail_safe_set = true;
+    }
+
+    // Returns true if its last frame is less than TRANSMITTER_LOST_FRAMES old
+    //
+    inline bool alive(const TPPM::FrameStamp &now)
+    {
+        return _heard && ((TPPM::FrameStamp)(now - _stamp) < TRANSMITTER_LOST_FRAMES);
+    }
+
+    inline uint8_t encoder_id()
+    {
+        return _encoder_id;
+    }
+
+    inline uint8_t priority()
+    {
+        return _priority;
+    }
+
+    // Returns the frames matching its fingerprint in a row, up to 255
+    //
+    inline uint8_t good_frames()
+    {
+        return _good_frames;
+    }
+
+    inline bool fail_safe_set()
+    {
+        return _fail_safe_set;
+    }
+
+    inline const TPPMFingerprint &fingerprint()
+    {
+        return _fingerprint;
+    }
+
+    inline const TPPM::ChannelWord *fail_safe()
+    {
+        return _fail_safe;
+    }
+
+    inline const TPPM::ChannelWord *channels()
+    {
+        return _channels;
+    }
+
+private:
+    uint8_t           _encoder_id   ; // 0: free entry
+    uint8_t           _priority     ;
+    uint8_t           _good_frames  ;
+    bool              _fail_safe_set;
+    bool              _heard        ; // at least a frame since the reset
+    TPPM::FrameStamp  _stamp        ; // of its last frame
+    TPPMFingerprint   _fingerprint  ;
+    TPPM::ChannelWord _fail_safe[CHANNEL_WORDS(MAX_CHANNELS)];
+    TPPM::ChannelWord _channels [CHANNEL_WORDS(MAX_CHANNELS)]; // of its last frame
+};
+
+#endif // __TPPM_TRANSMITTER_H__
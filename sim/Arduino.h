@@ -0,0 +1,69 @@
+#if !defined(__TPPM_SIM_ARDUINO_H__)
+#define __TPPM_SIM_ARDUINO_H__
+
+// Host replacement of the Arduino core for the TPPMSum simulator: just what
+// the decoder uses, the Timer1 registers being plain variables driven by the
+// simulator's virtual clock (see TPPMSim.h).
+
+#include <stdint.h>
+#include <stddef.h>
+
+#if !defined(F_CPU)
+#define F_CPU 16000000UL
+#endif
+
+// The interrupt handlers are plain functions, called by the simulator
+//
+#define ISR(vector)     extern "C" void vector(void)
+
+#define noInterrupts()
+#define interrupts()
+
+#define INPUT           0x0
+#define OUTPUT          0x1
+
+#define LOW             0x0
+#define HIGH            0x1
+
+#define bitSet(value, bit)   ((value) |=  (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+
+template <class A, class B> inline A min(const A &a, const B &b) { return (a < b) ? a : (A)b; }
+template <class A, class B> inline A max(const A &a, const B &b) { return (a > b) ? a : (A)b; }
+
+inline void pinMode     (uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+
+// Timer1, port B and pin change registers, defined by the simulator
+//
+extern volatile uint8_t  TCCR1A;
+extern volatile uint8_t  TCCR1B;
+extern volatile uint8_t  TCCR1C;
+extern volatile uint8_t  TIMSK1;
+extern volatile uint8_t  TIFR1 ;
+extern volatile uint8_t  SREG  ;
+extern volatile uint8_t  PINB  ;
+extern volatile uint8_t  PORTB ;
+extern volatile uint8_t  PCICR ;
+extern volatile uint8_t  PCMSK0;
+extern volatile uint16_t TCNT1 ;
+extern volatile uint16_t ICR1  ;
+
+enum
+{
+    // TCCR1A
+    WGM10 = 0, WGM11 = 1, COM1B0 = 4, COM1B1 = 5, COM1A0 = 6, COM1A1 = 7,
+    // TCCR1B
+    CS10  = 0, CS11  = 1, CS12   = 2, WGM12  = 3, WGM13  = 4, ICES1  = 6, ICNC1 = 7,
+    // TCCR1C
+    FOC1B = 6, FOC1A = 7,
+    // TIMSK1 / TIFR1
+    TOIE1 = 0, OCIE1A = 1, OCIE1B = 2, ICIE1 = 5,
+    TOV1  = 0, OCF1A  = 1, OCF1B  = 2, ICF1  = 5,
+    // PINB / PORTB
+    PINB0 = 0, PINB1 = 1, PORTB5 = 5,
+    // PCICR / PCMSK0
+    PCIE0 = 0, PCINT1 = 1
+};
+
+#endif // __TPPM_SIM_ARDUINO_H__
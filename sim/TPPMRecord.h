@@ -0,0 +1,205 @@
+#if !defined(__TPPM_RECORD_H__)
+#define __TPPM_RECORD_H__
+
+#include <stdio.h>
+#include <stdint.h>
+
+// Recorded edge streams file format.
+//
+// A signal is the line held at a level for a width (Timer1 ticks), then
+// toggled. Each signal is a varint (7 bits per byte, least significant
+// first, the high bit set on all but the last byte) of:
+//
+//   ( zigzag( width - previous width of the same level ) << 1 ) | level_bit
+//
+// where level_bit is 1 if the line did not toggle at the previous signal's
+// end (a missed edge), or, for the first signal after a restart point, the
+// level itself. The pulses repeat the previous width, the channels move by a
+// few ticks: most signals fit in 1 or 2 bytes.
+//
+// A restart point follows the first sync gap (a signal at least sync_width
+// long) ending index_interval ticks after the previous restart point: the
+// widths predictors are cleared there, so the decoding can start at any of
+// them. The file starts with a restart point.
+//
+// Layout, little endian:
+//
+//   header : "TPPMREC1", ticks per second (u32), index interval (u32), sync width (u32)
+//   signals: varints
+//   index  : { time (u64), offset (u64) } per restart point
+//   footer : index offset (u64), index entries (u32), "TPPMIDX1"
+//
+// The index is written when the recording is closed: a truncated recording
+// can still be read from its beginning, not seeked.
+//
+#define RECORD_MAGIC           "TPPMREC1"
+#define RECORD_INDEX_MAGIC     "TPPMIDX1"
+#define RECORD_MAGIC_SIZE      8
+#define RECORD_HEADER_SIZE     ( RECORD_MAGIC_SIZE + 3 * 4 )
+#define RECORD_INDEX_ENTRY     ( 2 * 8 )
+#define RECORD_FOOTER_SIZE     ( 8 + 4 + RECORD_MAGIC_SIZE )
+#define RECORD_MAX_VARINT      10
+
+namespace TPPMRecord
+{
+    inline uint64_t zigzag(const int64_t &value)
+    {
+        return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+    }
+
+    inline int64_t unzigzag(const uint64_t &value)
+    {
+        return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+    }
+
+    inline void put_varint(FILE *file, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            fputc((int)(value & 0x7f) | 0x80, file);
+
+            value >>= 7;
+        }
+
+        fputc((int)value, file);
+    }
+
+    inline bool get_varint(FILE *file, uint64_t &value)
+    {
+        value = 0;
+
+        for (uint8_t b=0; b<RECORD_MAX_VARINT; ++b)
+        {
+            int byte = fgetc(file);
+
+            if (EOF == byte)
+            {
+                return false;
+            }
+
+            value |= (uint64_t)(byte & 0x7f) << (7 * b);
+
+            if (0 == (byte & 0x80))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    inline void put_uint(FILE *file, uint64_t value, const uint8_t &bytes)
+    {
+        for (uint8_t b=0; b<bytes; ++b)
+        {
+            fputc((int)(value & 0xff), file);
+
+            value >>= 8;
+        }
+    }
+
+    inline bool get_uint(FILE *file, uint64_t &value, const uint8_t &bytes)
+    {
+        value = 0;
+
+        for (uint8_t b=0; b<bytes; ++b)
+        {
+            int byte = fgetc(file);
+
+            if (EOF == byte)
+            {
+                return false;
+            }
+
+            value |= (uint64_t)byte << (8 * b);
+        }
+
+        return true;
+    }
+
+    // The widths predictors and the restart points rule, shared by the writer
+    // and the reader so both see the same restart points
+    //
+    class Predictor
+    {
+    public:
+        Predictor()
+            : _index_interval(0)
+            , _sync_width    (0)
+        {
+            restart(0);
+        }
+
+        inline void setup(const uint32_t &index_interval, const uint32_t &sync_width)
+        {
+            _index_interval = index_interval;
+            _sync_width     = sync_width;
+        }
+
+        // Clear the predictors at a restart point
+        //
+        inline void restart(const uint64_t &time)
+        {
+            _width[0]   = 0;
+            _width[1]   = 0;
+            _level      = 0;
+            _restarted  = true;
+            _time       = time;
+            _next_index = time + _index_interval;
+        }
+
+        inline uint64_t encode(const uint8_t &level, const uint32_t &width)
+        {
+            uint8_t level_bit = _restarted ? level : (level == _level);
+
+            return (zigzag((int64_t)width - _width[level]) << 1) | level_bit;
+        }
+
+        inline void decode(const uint64_t &value, uint8_t &level, uint32_t &width)
+        {
+            level = (_restarted) ? (value & 1) : (_level ^ !(value & 1));
+            width = _width[level] + unzigzag(value >> 1);
+        }
+
+        // Account the signal, returns true if a restart point follows it
+        //
+        inline bool signal(const uint8_t &level, const uint32_t &width)
+        {
+            _width[level] = width;
+            _level        = !level; // the level after the signal's edge
+            _restarted    = false;
+            _time        += width;
+
+            if ((width >= _sync_width) && (_time >= _next_index))
+            {
+                restart(_time);
+
+                return true;
+            }
+
+            return false;
+        }
+
+        inline uint64_t time()
+        {
+            return _time;
+        }
+
+    private:
+        uint32_t _index_interval;
+        uint32_t _sync_width    ;
+        uint32_t _width[2]      ; // per level
+        uint8_t  _level         ; // expected level of the next signal
+        bool     _restarted     ;
+        uint64_t _time          ;
+        uint64_t _next_index    ;
+    };
+
+    struct IndexEntry
+    {
+        uint64_t time  ;
+        uint64_t offset;
+    };
+};
+
+#endif // __TPPM_RECORD_H__
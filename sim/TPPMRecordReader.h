@@ -0,0 +1,223 @@
+#if !defined(__TPPM_RECORD_READER_H__)
+#define __TPPM_RECORD_READER_H__
+
+#include <string.h>
+#include <vector>
+
+#include "TPPMRecord.h"
+
+// Reads an edge stream from a recording (see TPPMRecord.h), one signal at a
+// time: nothing is decompressed ahead of the signals being played.
+//
+class TPPMRecordReader
+{
+public:
+    TPPMRecordReader()
+        : _file            (NULL)
+        , _ticks_per_second(0)
+        , _signals_end     (0)
+    {}
+
+    ~TPPMRecordReader()
+    {
+        close();
+    }
+
+    // Open the recording, and load its index if it has one
+    //
+    inline bool open(const char *path)
+    {
+        close();
+
+        _file = fopen(path, "rb");
+
+        if (NULL == _file)
+        {
+            return false;
+        }
+
+        char     magic[RECORD_MAGIC_SIZE];
+        uint64_t ticks_per_second;
+        uint64_t index_interval;
+        uint64_t sync_width;
+
+        if ((RECORD_MAGIC_SIZE != fread(magic, 1, RECORD_MAGIC_SIZE, _file))
+            ||
+            (0 != memcmp(magic, RECORD_MAGIC, RECORD_MAGIC_SIZE))
+            ||
+            !TPPMRecord::get_uint(_file, ticks_per_second, 4)
+            ||
+            !TPPMRecord::get_uint(_file, index_interval  , 4)
+            ||
+            !TPPMRecord::get_uint(_file, sync_width      , 4))
+        {
+            close();
+
+            return false;
+        }
+
+        _ticks_per_second = ticks_per_second;
+        _signals_end      = load_index();
+
+        _predictor.setup(index_interval, sync_width);
+
+        restart(0, RECORD_HEADER_SIZE);
+
+        return true;
+    }
+
+    inline void close()
+    {
+        if (NULL != _file)
+        {
+            fclose(_file);
+
+            _file = NULL;
+        }
+
+        _index.clear();
+    }
+
+    // Read the next signal, returns false at the end of the recording
+    //
+    inline bool next(uint8_t &level, uint32_t &width)
+    {
+        uint64_t value;
+
+        if ((0 != _signals_end) && ((uint64_t)ftell(_file) >= _signals_end))
+        {
+            return false;
+        }
+
+        if (!TPPMRecord::get_varint(_file, value))
+        {
+            return false;
+        }
+
+        _predictor.decode(value, level, width);
+        _predictor.signal(level, width);
+
+        return true;
+    }
+
+    // Move to the last restart point at or before the given time, returns
+    // false if the recording has no index
+    //
+    inline bool seek(const uint64_t &time)
+    {
+        if (_index.empty())
+        {
+            return false;
+        }
+
+        size_t lo = 0;
+        size_t hi = _index.size();
+
+        while ((hi - lo) > 1)
+        {
+            size_t mid = (lo + hi) / 2;
+
+            if (_index[mid].time <= time)
+            {
+                lo = mid;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+
+        restart(_index[lo].time, _index[lo].offset);
+
+        return true;
+    }
+
+    // Time at the end of the last signal read, ticks
+    //
+    inline uint64_t time()
+    {
+        return _predictor.time();
+    }
+
+    inline uint32_t ticks_per_second()
+    {
+        return _ticks_per_second;
+    }
+
+    inline size_t restart_points()
+    {
+        return _index.size();
+    }
+
+private:
+    FILE                                *_file            ;
+    uint32_t                             _ticks_per_second;
+    uint64_t                             _signals_end     ; // 0 if unknown
+    TPPMRecord::Predictor                _predictor       ;
+    std::vector<TPPMRecord::IndexEntry>  _index           ;
+
+    inline void restart(const uint64_t &time, const uint64_t &offset)
+    {
+        fseek(_file, offset, SEEK_SET);
+
+        _predictor.restart(time);
+    }
+
+    // Returns the offset of the index, the end of the signals, 0 if missing
+    // or if the footer does not match the file size
+    //
+    inline uint64_t load_index()
+    {
+        char     magic[RECORD_MAGIC_SIZE];
+        uint64_t index_offset;
+        uint64_t entries;
+
+        if (0 != fseek(_file, 0, SEEK_END))
+        {
+            return 0;
+        }
+
+        long size = ftell(_file);
+
+        if ((size < (long)(RECORD_HEADER_SIZE + RECORD_FOOTER_SIZE))
+            ||
+            (0 != fseek(_file, -RECORD_FOOTER_SIZE, SEEK_END))
+            ||
+            !TPPMRecord::get_uint(_file, index_offset, 8)
+            ||
+            !TPPMRecord::get_uint(_file, entries     , 4)
+            ||
+            (RECORD_MAGIC_SIZE != fread(magic, 1, RECORD_MAGIC_SIZE, _file))
+            ||
+            (0 != memcmp(magic, RECORD_INDEX_MAGIC, RECORD_MAGIC_SIZE))
+            ||
+            (index_offset < RECORD_HEADER_SIZE)
+            ||
+            (index_offset > (uint64_t)size)
+            ||
+            (index_offset + entries * RECORD_INDEX_ENTRY + RECORD_FOOTER_SIZE != (uint64_t)size)
+            ||
+            (0 != fseek(_file, index_offset, SEEK_SET)))
+        {
+            return 0;
+        }
+
+        _index.resize(entries);
+
+        for (size_t e=0; e<entries; ++e)
+        {
+            if (!TPPMRecord::get_uint(_file, _index[e].time  , 8)
+                ||
+                !TPPMRecord::get_uint(_file, _index[e].offset, 8))
+            {
+                _index.clear();
+
+                return 0;
+            }
+        }
+
+        return index_offset;
+    }
+};
+
+#endif // __TPPM_RECORD_READER_H__
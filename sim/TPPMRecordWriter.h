@@ -0,0 +1,110 @@
+#if !defined(__TPPM_RECORD_WRITER_H__)
+#define __TPPM_RECORD_WRITER_H__
+
+#include <vector>
+
+#include "TPPMRecord.h"
+
+// Writes an edge stream to a recording (see TPPMRecord.h)
+//
+class TPPMRecordWriter
+{
+public:
+    TPPMRecordWriter()
+        : _file(NULL)
+    {}
+
+    ~TPPMRecordWriter()
+    {
+        close();
+    }
+
+    // Create the recording.
+    //
+    // - ticks_per_second : the signals widths unit
+    // - index_interval   : the minimum time between restart points, ticks
+    // - sync_width       : the minimum width of a sync gap, ticks
+    //
+    inline bool open(const char     *path            ,
+                     const uint32_t &ticks_per_second,
+                     const uint32_t &index_interval  ,
+                     const uint32_t &sync_width      )
+    {
+        close();
+
+        _file = fopen(path, "wb");
+
+        if (NULL == _file)
+        {
+            return false;
+        }
+
+        fwrite(RECORD_MAGIC, 1, RECORD_MAGIC_SIZE, _file);
+
+        TPPMRecord::put_uint(_file, ticks_per_second, 4);
+        TPPMRecord::put_uint(_file, index_interval  , 4);
+        TPPMRecord::put_uint(_file, sync_width      , 4);
+
+        _predictor.setup(index_interval, sync_width);
+        _predictor.restart(0);
+
+        _index.clear();
+
+        add_index_entry();
+
+        return true;
+    }
+
+    // Append a signal: the line held at the level for the width, then toggled
+    //
+    inline void signal(const uint8_t &level, const uint32_t &width)
+    {
+        TPPMRecord::put_varint(_file, _predictor.encode(level, width));
+
+        if (_predictor.signal(level, width))
+        {
+            add_index_entry();
+        }
+    }
+
+    // Write the index and close the recording
+    //
+    inline void close()
+    {
+        if (NULL == _file)
+        {
+            return;
+        }
+
+        uint64_t index_offset = ftell(_file);
+
+        for (size_t e=0; e<_index.size(); ++e)
+        {
+            TPPMRecord::put_uint(_file, _index[e].time  , 8);
+            TPPMRecord::put_uint(_file, _index[e].offset, 8);
+        }
+
+        TPPMRecord::put_uint(_file, index_offset , 8);
+        TPPMRecord::put_uint(_file, _index.size(), 4);
+
+        fwrite(RECORD_INDEX_MAGIC, 1, RECORD_MAGIC_SIZE, _file);
+
+        fclose(_file);
+
+        _file = NULL;
+    }
+
+private:
+    FILE                                *_file     ;
+    TPPMRecord::Predictor                _predictor;
+    std::vector<TPPMRecord::IndexEntry>  _index    ;
+
+    inline void add_index_entry()
+    {
+        TPPMRecord::IndexEntry entry = { _predictor.time(), (uint64_t)ftell(_file) };
+
+        _index.push_back(entry);
+    }
+};
+
+#endif // __TPPM_RECORD_WRITER_H__
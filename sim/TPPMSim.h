@@ -0,0 +1,439 @@
+#if !defined(__TPPM_SIM_H__)
+#define __TPPM_SIM_H__
+
+#include <Arduino.h>
+#include <time.h>
+
+#include "TPPMSum.h"
+#include "TPPMEncoder.h"
+
+// The virtual time of the last simulator advanced, for the simulated EEPROM
+//
+extern uint64_t sim_clock;
+
+// Signals of a frame: a pulse and a gap per channel, the last pulse and the
+// sync gap
+//
+#define SIM_FRAME_SIGNALS ( ( MAX_CHANNELS + 1 ) * 2 )
+
+// Drives a TPPMSum decoder with an edge stream on a virtual clock.
+//
+// The stream is played on the simulated ICP1 line: every edge selected by
+// ICES1 latches the virtual time into ICR1 and runs the real TIMER1_CAPT_vect,
+// at once or late (see delay_capture()), every Timer1
+// wrap around runs the real TIMER1_OVF_vect, and TCNT1 follows the virtual
+// time so the decoder's capture_clock() (watchdog, timeout()) sees it too.
+// Nothing waits for real time: hours of stream are played in seconds.
+// The interrupts disabled in TIMSK1 do not run.
+//
+// The decoder must have been started by init(), which attaches it to the
+// capture interrupt.
+//
+class TPPMSim
+{
+public:
+    // The edges captured, by the signal they end
+    //
+    enum Edge
+    {
+        SYNC_EDGE = 0, // a sync gap: the frame is checked
+        PULSE_EDGE   , // a pulse: a gap starts
+        GAP_EDGE     , // a channel gap: a pulse starts
+        EDGE_KINDS
+    };
+
+    // The host run times of the capture interrupt, in ns
+    //
+    struct RunTime
+    {
+        uint64_t worst;
+        uint64_t total;
+        uint64_t edges;
+    };
+
+    // Invoked after every edge, the decoder state can be queried from here
+    //
+    typedef void (*Probe)(TPPMSim &sim, void *context);
+
+    TPPMSim(TPPMSum &decoder, const uint8_t &pulse_level = HIGH)
+        : _decoder    (decoder    )
+        , _pulse_level(pulse_level)
+        , _probe      (NULL       )
+        , _context    (NULL       )
+        , _latency    (0          )
+        , _pending    (false      )
+        , _due        (0          )
+        , _width      (0          )
+    {
+        reset();
+
+        for (uint8_t e=0; e<EDGE_KINDS; ++e)
+        {
+            _run_time[e].worst = 0;
+            _run_time[e].total = 0;
+            _run_time[e].edges = 0;
+        }
+    }
+
+    // Restart the virtual clock, the line idle at the gaps level
+    //
+    inline void reset()
+    {
+        _time  = 0;
+        _edges = 0;
+        _level = !_pulse_level;
+
+        TCNT1  = 0;
+        ICR1   = 0;
+        TIFR1  = 0;
+        PINB   = _level << PINB0;
+    }
+
+    inline void set_probe(Probe probe, void *context)
+    {
+        _probe   = probe  ;
+        _context = context;
+    }
+
+    inline TPPMSum &decoder()
+    {
+        return _decoder;
+    }
+
+    // Virtual time since reset(), in Timer1 ticks
+    //
+    inline uint64_t now()
+    {
+        return _time;
+    }
+
+    // Virtual time since reset(), in seconds
+    //
+    inline double seconds()
+    {
+        return (double)_time / (TICKS_PER_MS * 1000.0);
+    }
+
+    inline uint64_t edges()
+    {
+        return _edges;
+    }
+
+    // Hold the line at the given level for the width, then toggle it
+    //
+    inline void signal(const uint8_t &level, const uint32_t &width)
+    {
+        _level = level;
+        _width = width;
+
+        hold(width);
+        capture();
+    }
+
+    // Hold the line at its current level for the width, no edges
+    //
+    inline void silence(const uint32_t &width)
+    {
+        hold(width);
+    }
+
+    // Run the interrupt of the next edge captured late by the latency, as
+    // another interrupt or a noInterrupts() section would: the edges in
+    // between toggle the line but are not captured
+    //
+    inline void delay_capture(const uint32_t &latency)
+    {
+        _latency = latency;
+    }
+
+    inline const RunTime &run_time(const Edge &edge)
+    {
+        return _run_time[edge];
+    }
+
+    // Returns the stages of work left of the frame just ended (see
+    // TPPMSum::commit_step())
+    //
+    inline uint8_t commit_stages()
+    {
+        return ((_decoder._commit & TPPMSum::COMMIT_MODULE) ? 1 : 0)
+               +
+               ((_decoder._commit & TPPMSum::COMMIT_LINK  ) ? 1 : 0)
+               +
+               ((_decoder._commit & TPPMSum::COMMIT_AGES  ) ? 1 : 0);
+    }
+
+    // Play a whole frame: pulses and gaps, then the sync gap
+    //
+    inline void play(const TPPMEncoder::Frame &frame)
+    {
+        for (uint8_t c=0; c<frame.channels; ++c)
+        {
+            signal( _pulse_level, frame.pulse_width[c]);
+            signal(!_pulse_level, frame.channel_width[c] - frame.pulse_width[c]);
+        }
+
+        signal( _pulse_level, frame.pulse_width[frame.channels]);
+        signal(!_pulse_level, frame.sync_width);
+    }
+
+private:
+    TPPMSum  &_decoder    ;
+    uint8_t   _pulse_level;
+    uint8_t   _level      ;
+    uint64_t  _time       ;
+    uint64_t  _edges      ;
+    Probe     _probe      ;
+    void     *_context    ;
+    uint32_t  _latency    ; // of the next interrupt
+    bool      _pending    ; // an interrupt waits to run...
+    uint64_t  _due        ; // ...at this time
+    uint32_t  _width      ; // of the last signal
+    RunTime   _run_time[EDGE_KINDS];
+
+    // Hold the line for the width, running a late interrupt when due
+    //
+    inline void hold(const uint32_t &width)
+    {
+        uint64_t end = _time + width;
+
+        if (_pending && (_due < end))
+        {
+            advance(_due - _time);
+            interrupt();
+        }
+
+        advance(end - _time);
+    }
+
+    inline void advance(const uint32_t &width)
+    {
+        uint64_t time = _time + width;
+
+        for (uint64_t wraps = (time >> 16) - (_time >> 16); wraps > 0; --wraps)
+        {
+            if (TIMSK1 & (1 << TOIE1))
+            {
+                TIMER1_OVF_vect();
+            }
+        }
+
+        _time     = time;
+        TCNT1     = (uint16_t)_time;
+        sim_clock = _time;
+    }
+
+    inline void capture()
+    {
+        _level = !_level;
+
+        PINB = _level << PINB0;
+
+        ++_edges;
+
+        if ((TIMSK1 & (1 << ICIE1)) && (((TCCR1B >> ICES1) & 0x01) == _level))
+        {
+            // The edge selected: latched even if its interrupt is pending
+            //
+            ICR1 = (uint16_t)_time;
+
+            if (0 != _latency)
+            {
+                _pending = true;
+                _due     = _time + _latency;
+                _latency = 0;
+            }
+            else
+            if (!_pending)
+            {
+                interrupt();
+
+                return;
+            }
+        }
+
+        probe();
+    }
+
+    inline void interrupt()
+    {
+        Edge            edge = (_width >= MIN_SYNC_WIDTH) ? SYNC_EDGE
+                             : (_level == _pulse_level)   ? GAP_EDGE
+                                                          : PULSE_EDGE;
+        struct timespec start;
+        struct timespec end;
+
+        _pending = false;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        TIMER1_CAPT_vect();
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        uint64_t ns = (uint64_t)(end.tv_sec - start.tv_sec) * 1000000000ULL + end.tv_nsec - start.tv_nsec;
+
+        if (ns > _run_time[edge].worst)
+        {
+            _run_time[edge].worst = ns;
+        }
+
+        _run_time[edge].total += ns;
+        _run_time[edge].edges += 1;
+
+        probe();
+    }
+
+    inline void probe()
+    {
+        if (NULL != _probe)
+        {
+            _probe(*this, _context);
+        }
+    }
+};
+
+// Drives two TPPMSum decoders, a diversity pair (see TPPMDiversity), with
+// two edge streams on the same virtual clock.
+//
+// The first stream is played on the simulated ICP1 line as by TPPMSim, the
+// second one on D9: every edge of it sets TCNT1 to the virtual time and runs
+// the real PCINT0_vect, when enabled in PCICR and PCMSK0. The edges of both
+// streams are played in time order.
+//
+// The decoders must have been started by init(), the second one on
+// TPPM::PCINT1_INPUT.
+//
+class TPPMDiversitySim
+{
+public:
+    TPPMDiversitySim(const uint8_t &pulse_level = HIGH)
+        : _pulse_level(pulse_level)
+    {
+        reset();
+    }
+
+    // Restart the virtual clock, the lines idle at the gaps level
+    //
+    inline void reset()
+    {
+        _time = 0;
+
+        _levels[0] = !_pulse_level;
+        _levels[1] = !_pulse_level;
+
+        TCNT1  = 0;
+        ICR1   = 0;
+        TIFR1  = 0;
+        PINB   = (_levels[0] << PINB0) | (_levels[1] << PINB1);
+    }
+
+    // Play a frame on each line at the same time: the sync gap of the shorter
+    // one is stretched, the next frames start together
+    //
+    inline void play(const TPPMEncoder::Frame &primary, const TPPMEncoder::Frame &secondary)
+    {
+        uint16_t signals[2][SIM_FRAME_SIGNALS];
+        uint8_t  counts [2];
+        uint32_t lengths[2];
+
+        counts[0] = load(primary  , signals[0], lengths[0]);
+        counts[1] = load(secondary, signals[1], lengths[1]);
+
+        uint8_t shorter = (lengths[0] < lengths[1]) ? 0 : 1;
+
+        signals[shorter][counts[shorter] - 1] += lengths[!shorter] - lengths[shorter];
+
+        uint64_t start    = _time;
+        uint64_t edges[2] = { start + signals[0][0], start + signals[1][0] };
+        uint8_t  next [2] = { 0, 0 };
+
+        while ((next[0] < counts[0]) || (next[1] < counts[1]))
+        {
+            uint8_t line = (next[1] >= counts[1]) ? 0
+                         : (next[0] >= counts[0]) ? 1
+                         : ((edges[1] < edges[0]) ? 1 : 0);
+
+            // The pulses are the even signals, each one toggles the line at its end
+            //
+            _levels[line] = (next[line] & 1) ? !_pulse_level : _pulse_level;
+
+            advance(edges[line] - _time);
+            capture(line);
+
+            if (++next[line] < counts[line])
+            {
+                edges[line] += signals[line][next[line]];
+            }
+        }
+    }
+
+private:
+    uint8_t   _pulse_level;
+    uint8_t   _levels[2]  ;
+    uint64_t  _time       ;
+
+    // Returns the signals of the frame, and its length
+    //
+    inline uint8_t load(const TPPMEncoder::Frame &frame, uint16_t *signals, uint32_t &length)
+    {
+        uint8_t count = 0;
+
+        length = 0;
+
+        for (uint8_t c=0; c<frame.channels; ++c)
+        {
+            signals[count++] = frame.pulse_width[c];
+            signals[count++] = frame.channel_width[c] - frame.pulse_width[c];
+
+            length += frame.channel_width[c];
+        }
+
+        signals[count++] = frame.pulse_width[frame.channels];
+        signals[count++] = frame.sync_width;
+
+        length += frame.pulse_width[frame.channels] + frame.sync_width;
+
+        return count;
+    }
+
+    inline void advance(const uint64_t &width)
+    {
+        uint64_t time = _time + width;
+
+        for (uint64_t wraps = (time >> 16) - (_time >> 16); wraps > 0; --wraps)
+        {
+            if (TIMSK1 & (1 << TOIE1))
+            {
+                TIMER1_OVF_vect();
+            }
+        }
+
+        _time     = time;
+        TCNT1     = (uint16_t)_time;
+        sim_clock = _time;
+    }
+
+    inline void capture(const uint8_t &line)
+    {
+        _levels[line] = !_levels[line];
+
+        PINB = (_levels[0] << PINB0) | (_levels[1] << PINB1);
+
+        if (0 == line)
+        {
+            if ((TIMSK1 & (1 << ICIE1)) && (((TCCR1B >> ICES1) & 0x01) == _levels[0]))
+            {
+                ICR1 = (uint16_t)_time;
+
+                TIMER1_CAPT_vect();
+            }
+        }
+        else if ((PCICR & (1 << PCIE0)) && (PCMSK0 & (1 << PCINT1)))
+        {
+            PCINT0_vect();
+        }
+    }
+};
+
+#endif // __TPPM_SIM_H__
@@ -0,0 +1,42 @@
+#if !defined(__TPPM_SIM_AVR_EEPROM_H__)
+#define __TPPM_SIM_AVR_EEPROM_H__
+
+// Simulated EEPROM (ATmega328 sized): a plain array, defined by the simulator,
+// busy for sim_eeprom_write_time after each byte written, on the simulator's
+// virtual clock (sim_clock, Timer1 ticks)
+//
+#include <stdint.h>
+
+#define E2END           0x3ff
+
+extern uint8_t sim_eeprom[E2END + 1];
+extern uint32_t sim_eeprom_writes;
+extern uint64_t sim_clock;
+extern uint64_t sim_eeprom_written;
+extern const uint32_t sim_eeprom_write_time;
+
+inline uint8_t eeprom_read_byte(const uint8_t *address)
+{
+    return sim_eeprom[(uintptr_t)address];
+}
+
+inline void eeprom_update_byte(uint8_t *address, uint8_t value)
+{
+    if (sim_eeprom[(uintptr_t)address] != value)
+    {
+        sim_eeprom[(uintptr_t)address] = value;
+
+        sim_eeprom_written = sim_clock;
+
+        ++sim_eeprom_writes;
+    }
+}
+
+// A clock gone back (another simulator restarted it) finds the EEPROM ready
+//
+inline bool eeprom_is_ready()
+{
+    return (sim_clock - sim_eeprom_written) >= sim_eeprom_write_time;
+}
+
+#endif // __TPPM_SIM_AVR_EEPROM_H__
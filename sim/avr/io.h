@@ -0,0 +1,8 @@
+#if !defined(__TPPM_SIM_AVR_IO_H__)
+#define __TPPM_SIM_AVR_IO_H__
+
+// The simulated AVR registers are declared by the simulated Arduino.h
+//
+#include "Arduino.h"
+
+#endif // __TPPM_SIM_AVR_IO_H__
@@ -0,0 +1,2080 @@
+// TPPMSum decoder simulator: replays an edge stream into the decoder on a
+// virtual clock, thousands of times faster than real time.
+//
+// Build on the host (no Arduino core needed, see sim/Arduino.h):
+//
+//   g++ -O2 -I sim -I . sim/tppmsim.cpp TPPMSum.cpp -o tppmsim
+//
+// Usage:
+//
+//   tppmsim                               run the built-in scenarios
+//   tppmsim <edges.txt>                   replay a text edge stream
+//   tppmsim <edges.tpr> [start seconds]   replay a recording, from the given time
+//   tppmsim -c <edges.txt> <edges.tpr>    convert a text edge stream to a recording
+//
+// The text edge stream has a line per signal: its level (0 or 1) and its
+// width in microseconds, the line toggling at its end. '#' starts a comment.
+//
+//   # 8 channels frame, 300 us pulses
+//   1 300
+//   0 1200
+//   ...
+//
+// The recordings are delta coded, seekable, binary files (see TPPMRecord.h).
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "TPPMSim.h"
+#include "TPPMRecordWriter.h"
+#include "TPPMRecordReader.h"
+#include "TPPMRecorder.h"
+#include "TPPMLock.h"
+#include "TPPMDiversity.h"
+
+// The simulated registers
+//
+volatile uint8_t  TCCR1A = 0;
+volatile uint8_t  TCCR1B = 0;
+volatile uint8_t  TCCR1C = 0;
+volatile uint8_t  TIMSK1 = 0;
+volatile uint8_t  TIFR1  = 0;
+volatile uint8_t  SREG   = 0;
+volatile uint8_t  PINB   = 0;
+volatile uint8_t  PORTB  = 0;
+volatile uint8_t  PCICR  = 0;
+volatile uint8_t  PCMSK0 = 0;
+volatile uint16_t TCNT1  = 0;
+volatile uint16_t ICR1   = 0;
+
+// The simulated EEPROM, virgin, and its byte write time (ATmega328: 3.3 mS)
+//
+uint8_t        sim_eeprom[E2END + 1];
+uint32_t       sim_eeprom_writes     = 0;
+uint64_t       sim_eeprom_written    = 0;
+const uint32_t sim_eeprom_write_time = USEC_TO_WIDTH( 3300 );
+
+// The virtual time of the simulator running, for the EEPROM
+//
+uint64_t sim_clock = 0;
+
+#define PLAIN_CHANNELS        8
+#define PLAIN_PULSE_WIDTH     USEC_TO_WIDTH( 300 )
+#define PLAIN_FRAME_PERIOD    USEC_TO_WIDTH( 22500 )
+
+// A channel too wide to be a channel and too narrow to be a sync
+//
+#define BAD_CHANNEL_WIDTH     USEC_TO_WIDTH( 2300 )
+
+#define SOAK_SECONDS          3600
+
+#define RECORD_SECONDS        600
+#define RECORD_INDEX_INTERVAL MSEC_TO_WIDTH( 1000UL )
+#define TICKS_PER_SECOND      ( TICKS_PER_MS * 1000UL )
+
+#define FLIGHT_FRAMES         2000
+
+// With extended addressing a tagged stream may take PAGE_WAIT_FRAMES more to
+// lock, the decoder waits for a page select, and a multiplex cycle may last
+// PAGE_SELECT_FRAMES more, the page select frames refresh no channels
+//
+#if defined(TPPM_EXTENDED_ADDRESS)
+#define PAGE_SELECT_FRAMES    EXTENDED_PAGE_FRAMES
+#define PAGE_WAIT_FRAMES      ( EXTENDED_PAGE_PERIOD + EXTENDED_PAGE_FRAMES )
+#else
+#define PAGE_SELECT_FRAMES    0
+#define PAGE_WAIT_FRAMES      0
+#endif
+
+#define WITHIN_PAGE_SELECT(cycle,frames) ( ( (cycle) >= (frames) ) && ( (cycle) <= (frames) + PAGE_SELECT_FRAMES ) )
+
+static TPPMSum             decoder;
+static TPPM::BasicChannels basic_channels;
+static TPPM::ExtraChannels extra_channels;
+static TPPM::OnOffChannels onoff_channels;
+
+static int failures = 0;
+
+static void check(const bool &passed, const char *what)
+{
+    printf("  %-48s %s\n", what, passed ? "ok" : "FAILED");
+
+    if (!passed)
+    {
+        ++failures;
+    }
+}
+
+// Reports the decoder state changes
+//
+struct Tracer
+{
+    bool capturing;
+    bool initializing;
+    bool fail_safe;
+};
+
+static void trace(TPPMSim &sim, void *context)
+{
+    Tracer  &last = *(Tracer *)context;
+    TPPMSum &d    = sim.decoder();
+
+    Tracer now = { d.capturing(), d.initializing(), d.fail_safe() };
+
+    if (memcmp(&now, &last, sizeof(now)))
+    {
+        printf("%12.6f s: %s%s%s\n",
+               sim.seconds(),
+               now.capturing    ? "capturing"   : "searching",
+               now.initializing ? " initializing" : "",
+               now.fail_safe    ? " fail-safe"  : "");
+
+        last = now;
+    }
+}
+
+static void plain_frame(TPPMEncoder::Frame &frame, const uint16_t &value)
+{
+    uint16_t channels[PLAIN_CHANNELS];
+
+    for (uint8_t c=0; c<PLAIN_CHANNELS; ++c)
+    {
+        channels[c] = value + USEC_TO_WIDTH( 10 ) * c;
+    }
+
+    TPPMEncoder::plain(frame, channels, PLAIN_CHANNELS, PLAIN_PULSE_WIDTH, PLAIN_FRAME_PERIOD);
+}
+
+static void bad_frame(TPPMEncoder::Frame &frame)
+{
+    plain_frame(frame, USEC_TO_WIDTH( 1500 ));
+
+    frame.channel_width[PLAIN_CHANNELS / 2] = BAD_CHANNEL_WIDTH;
+
+    frame.sync_width -= BAD_CHANNEL_WIDTH - USEC_TO_WIDTH( 1500 );
+}
+
+// Play a frame, the interrupt of the leading edge of the pulse late by the
+// latency
+//
+static void play_late(TPPMSim &sim, const TPPMEncoder::Frame &frame, const uint8_t &pulse, const uint32_t &latency)
+{
+    for (uint8_t c=0; c<frame.channels; ++c)
+    {
+        sim.signal(HIGH, frame.pulse_width[c]);
+
+        if (pulse == c + 1)
+        {
+            sim.delay_capture(latency);
+        }
+
+        sim.signal(LOW, frame.channel_width[c] - frame.pulse_width[c]);
+    }
+
+    sim.signal(HIGH, frame.pulse_width[frame.channels]);
+    sim.signal(LOW , frame.sync_width);
+}
+
+// Play good frames until the decoder locks, returns the frames played
+//
+static uint32_t acquire(TPPMSim &sim, const uint32_t &max_frames)
+{
+    TPPMEncoder::Frame frame;
+
+    plain_frame(frame, USEC_TO_WIDTH( 1500 ));
+
+    for (uint32_t f=1; f<=max_frames; ++f)
+    {
+        sim.play(frame);
+
+        if (!decoder.initializing())
+        {
+            return f;
+        }
+    }
+
+    return 0;
+}
+
+// A fresh decoder started with the given id and played by its own simulator,
+// and a tagged transmitter with all its channels centered and its switches off
+//
+struct Bench
+{
+    TPPMSum             fresh  ;
+    TPPMSim             replay ;
+    TPPMEncoder         encoder;
+    TPPMEncoder::Frame  frame  ;
+    TPPM::BasicChannels basic  ;
+    TPPM::ExtraChannels extra  ;
+    TPPM::OnOffChannels onoff  ;
+
+    Bench(const uint16_t &decoder_id = 1, const TPPMTag::Layout &layout = TPPMTag::LAYOUT_10CH)
+        : replay (fresh)
+        , encoder(5, layout)
+    {
+        for (uint8_t c=0; c<BASIC_CHANNELS_COUNT; ++c)
+        {
+            basic[c] = USEC_TO_WIDTH( 1500 );
+        }
+
+        for (uint8_t c=0; c<EXTRA_CHANNELS_COUNT; ++c)
+        {
+            extra[c] = USEC_TO_WIDTH( 1500 );
+        }
+
+        memset(onoff, 0, sizeof(onoff));
+
+        fresh.init(decoder_id, NULL, NULL, NULL, USEC_TO_WIDTH( 1500 ), false);
+    }
+
+    // Encode the channels to the decoder and sub-module, and play the frame
+    //
+    inline void send(const uint16_t &decoder_id, const uint8_t &module)
+    {
+        encoder.encode(frame, decoder_id, module, basic, extra, onoff);
+
+        replay.play(frame);
+    }
+};
+
+// Feed the tag with the pulses of a tagged frame, returns true if valid
+//
+static bool tag_frame(TPPMTag &tag, const TPPMEncoder::Frame &frame)
+{
+    for (uint8_t p=0; p<=frame.channels; ++p)
+    {
+        tag.update(p + 1, frame.pulse_width[p]);
+    }
+
+    tag.finish();
+
+    return tag.is_valid();
+}
+
+struct FlightLog
+{
+    uint32_t frames;
+    uint32_t good_frames;
+    uint16_t last_good_value;
+    uint16_t last_value;
+    bool     last_good_frame;
+    bool     fail_safe;
+};
+
+static void flight_entry(const TPPMRecorder::Entry &entry, void *context)
+{
+    FlightLog &log = *(FlightLog *)context;
+
+    log.frames     += entry.frames;
+    log.fail_safe   = entry.fail_safe;
+    log.last_value  = entry.channels[0];
+
+    if (entry.good && !entry.fail_safe)
+    {
+        log.good_frames     += entry.frames;
+        log.last_good_value  = entry.channels[0];
+        log.last_good_frame  = true;
+    }
+}
+
+static void scenarios()
+{
+    TPPMSim            sim(decoder);
+    TPPMEncoder::Frame good;
+    TPPMEncoder::Frame bad;
+
+    plain_frame(good, USEC_TO_WIDTH( 1500 ));
+    bad_frame  (bad);
+
+    printf("acquisition\n");
+    {
+        uint32_t frames = acquire(sim, 100);
+
+        printf("  locked after %u frames, %.3f s\n", frames, sim.seconds());
+
+        // The first sync starts the search, the first frame is the reference
+        //
+        check(frames == GOOD_FRAMES_COUNT + 1, "locks after GOOD_FRAMES_COUNT frames");
+
+        decoder.read(basic_channels, extra_channels, onoff_channels);
+
+        check(WIDTH_TO_USEC(basic_channels[0]) == 1500, "reads the channels");
+        check(decoder.extra_channels_count() == PLAIN_CHANNELS - BASIC_CHANNELS_COUNT, "counts the extra channels");
+    }
+
+    printf("hold\n");
+    {
+        uint32_t frames = 0;
+
+        while (!decoder.fail_safe() && (frames < 1000))
+        {
+            sim.play(bad);
+
+            ++frames;
+        }
+
+        printf("  fail-safe after %u bad frames\n", frames);
+
+        check(frames == HOLD_FRAMES_COUNT, "holds HOLD_FRAMES_COUNT bad frames");
+    }
+
+    printf("recovery\n");
+    {
+        sim.play(good);
+
+        check(!decoder.fail_safe(), "leaves fail-safe on the first good frame");
+    }
+
+    printf("watchdog\n");
+    {
+        uint64_t start = sim.now();
+
+        while (!decoder.fail_safe() && ((sim.now() - start) < MSEC_TO_WIDTH( 60000ULL )))
+        {
+            sim.silence(MSEC_TO_WIDTH( 10 ));
+        }
+
+        double seconds = (double)(sim.now() - start) / (TICKS_PER_MS * 1000.0);
+
+        printf("  fail-safe after %.2f s of silence\n", seconds);
+
+        check((seconds >= WATCHDOG_TIMEOUT_MS / 1000.0) && (seconds < WATCHDOG_TIMEOUT_MS / 1000.0 + 0.1),
+              "expires after WATCHDOG_TIMEOUT_MS");
+
+        // Beyond the 32 bits timebase wrap around, left unpolled meanwhile
+        //
+        while ((sim.now() - start) < MSEC_TO_WIDTH( 2150000ULL ))
+        {
+            sim.silence(MSEC_TO_WIDTH( 10000 ));
+        }
+
+        check(decoder.fail_safe() && decoder.timeout(), "stays in fail-safe past the timebase wrap around");
+
+        // The silence ends the first frame's first pulse: that frame is bad
+        //
+        sim.play(good);
+        sim.play(good);
+
+        check(!decoder.fail_safe(), "leaves fail-safe when the frames come back");
+    }
+
+    printf("soak (%u s with noise bursts)\n", SOAK_SECONDS);
+    {
+        Tracer  tracer = { decoder.capturing(), decoder.initializing(), decoder.fail_safe() };
+        clock_t wall   = clock();
+
+        uint64_t end       = sim.now() + MSEC_TO_WIDTH( SOAK_SECONDS * 1000ULL );
+        uint32_t frames    = 0;
+        uint32_t fail_safe = 0;
+        uint32_t glitches  = 0;
+
+        srand(1);
+
+        sim.set_probe(trace, &tracer);
+
+        while (sim.now() < end)
+        {
+            // Every about 5 minutes a burst of 30 bad frames, a single bad frame
+            // every about 50 otherwise
+            //
+            if (0 == (rand() % 13333))
+            {
+                for (uint8_t b=1; b<30; ++b)
+                {
+                    sim.play(bad);
+
+                    fail_safe += decoder.fail_safe() ? 1 : 0;
+
+                    ++frames;
+                }
+
+                sim.play(bad);
+
+                ++glitches;
+            }
+            else
+            if (0 == (rand() % 50))
+            {
+                sim.play(bad);
+            }
+            else
+            {
+                sim.play(good);
+            }
+
+            fail_safe += decoder.fail_safe() ? 1 : 0;
+
+            ++frames;
+        }
+
+        sim.set_probe(NULL, NULL);
+
+        double wall_seconds = (double)(clock() - wall) / CLOCKS_PER_SEC;
+
+        printf("  %u frames, %u bursts, %u frames in fail-safe\n", frames, glitches, fail_safe);
+        printf("  %.0f s simulated in %.3f s (%.0fx real time)\n",
+               (double)SOAK_SECONDS, wall_seconds,
+               (wall_seconds > 0) ? SOAK_SECONDS / wall_seconds : 0.0);
+
+        check(fail_safe <= glitches * (30 - HOLD_FRAMES_COUNT + 1), "fail-safe only on the long bursts");
+        check(!decoder.fail_safe() && !decoder.initializing(), "still locked at the end");
+    }
+
+    printf("recording (%u s)\n", RECORD_SECONDS);
+    {
+        char             path[] = "/tmp/tppmsimXXXXXX";
+        TPPMRecordWriter writer;
+        TPPMRecordReader reader;
+        uint64_t         edges = 0;
+        uint64_t         text  = 0;
+        uint64_t         time  = 0;
+
+        close(mkstemp(path));
+
+        writer.open(path, TICKS_PER_SECOND, RECORD_INDEX_INTERVAL, MIN_SYNC_WIDTH);
+
+        srand(2);
+
+        while (time < (uint64_t)RECORD_SECONDS * TICKS_PER_SECOND)
+        {
+            // Moving sticks
+            //
+            TPPMEncoder::Frame frame;
+
+            plain_frame(frame, USEC_TO_WIDTH( 1000 + (rand() % 1000) ));
+
+            for (uint8_t c=0; c<frame.channels; ++c)
+            {
+                writer.signal(HIGH, frame.pulse_width[c]);
+                writer.signal(LOW , frame.channel_width[c] - frame.pulse_width[c]);
+
+                text += snprintf(NULL, 0, "1 %u\n0 %u\n",
+                                 (unsigned)WIDTH_TO_USEC(frame.pulse_width[c]),
+                                 (unsigned)WIDTH_TO_USEC(frame.channel_width[c] - frame.pulse_width[c]));
+            }
+
+            writer.signal(HIGH, frame.pulse_width[frame.channels]);
+            writer.signal(LOW , frame.sync_width);
+
+            text  += snprintf(NULL, 0, "1 %u\n0 %u\n",
+                              (unsigned)WIDTH_TO_USEC(frame.pulse_width[frame.channels]),
+                              (unsigned)WIDTH_TO_USEC(frame.sync_width));
+            edges += 2 * (frame.channels + 1);
+            time  += PLAIN_FRAME_PERIOD;
+        }
+
+        writer.close();
+
+        FILE *file  = fopen(path, "rb");
+
+        fseek(file, 0, SEEK_END);
+
+        long  bytes = ftell(file);
+
+        fclose(file);
+
+        printf("  %llu edges in %ld bytes (%.2f bytes per edge)\n",
+               (unsigned long long)edges, bytes, (double)bytes / edges);
+        printf("  %.1fx smaller than text, %.0fx smaller than 1 MS/s samples\n",
+               (double)text / bytes, (RECORD_SECONDS * 1e6) / bytes);
+
+        check(reader.open(path), "opens the recording");
+        check(reader.restart_points() * (RECORD_INDEX_INTERVAL + PLAIN_FRAME_PERIOD) >= time, "indexes every second");
+
+        // Seek to the middle and decode from there with a fresh decoder
+        //
+        uint64_t target = (uint64_t)(RECORD_SECONDS / 2) * TICKS_PER_SECOND;
+
+        check(reader.seek(target) && (reader.time() <= target) && ((target - reader.time()) <= PLAIN_FRAME_PERIOD + RECORD_INDEX_INTERVAL),
+              "seeks to the middle");
+
+        Bench    bench;
+        uint8_t  level;
+        uint32_t width;
+        uint64_t played = 0;
+
+        while (reader.next(level, width))
+        {
+            bench.replay.signal(level, width);
+
+            ++played;
+        }
+
+        check((played > 0) && (reader.time() == time), "reads to the end");
+        check(bench.fresh.capturing() && !bench.fresh.fail_safe(), "decodes from the middle");
+
+        // A corrupt index count in the footer: the index is ignored, not
+        // allocated
+        //
+        file = fopen(path, "r+b");
+
+        fseek(file, 8 - RECORD_FOOTER_SIZE, SEEK_END);
+        fputc(0xff, file);
+        fputc(0xff, file);
+        fputc(0xff, file);
+        fputc(0xff, file);
+        fclose(file);
+
+        check(reader.open(path) && (0 == reader.restart_points()) && !reader.seek(target),
+              "ignores an index not matching the file size");
+
+        remove(path);
+
+        // Back to the scenarios decoder
+        //
+        decoder.init(1, basic_channels, extra_channels, onoff_channels, USEC_TO_WIDTH( 1500 ), false);
+    }
+
+    printf("tag code\n");
+    {
+        uint32_t clean     = 0;
+        uint32_t corrected = 0;
+        uint32_t detected  = 0;
+
+        for (uint32_t data=0; data<0x10000; ++data)
+        {
+            uint32_t code = TPPMTagCode::encode(data);
+            uint16_t decoded;
+
+            clean += (TPPMTagCode::CLEAN == TPPMTagCode::decode(code, decoded)) && (decoded == data);
+
+            for (uint8_t a=0; a<TAG_CODE_BITS; ++a)
+            {
+                corrected += (TPPMTagCode::CORRECTED == TPPMTagCode::decode(code ^ (1UL << a), decoded)) && (decoded == data);
+
+                if (0 == (data & 0xff))
+                {
+                    for (uint8_t b=a+1; b<TAG_CODE_BITS; ++b)
+                    {
+                        detected += (TPPMTagCode::FAILED == TPPMTagCode::decode(code ^ (1UL << a) ^ (1UL << b), decoded));
+                    }
+                }
+            }
+        }
+
+        check(clean     == 0x10000                                          , "decodes all the codes");
+        check(corrected == 0x10000 * TAG_CODE_BITS                          , "corrects all the single errors");
+        check(detected  == 0x100 * (TAG_CODE_BITS * (TAG_CODE_BITS - 1) / 2), "detects all the double errors");
+
+        // A tagged frame with a pulse read one level off
+        //
+        Bench               bench;
+        TPPMEncoder::Frame &frame = bench.frame;
+        TPPMTag             tag;
+
+        tag.set_decoder_id(1);
+
+#if defined(TPPM_EXTENDED_ADDRESS)
+        // The page select frames first
+        //
+        for (uint8_t f=0; f<EXTENDED_PAGE_FRAMES; ++f)
+        {
+            bench.encoder.encode(frame, 1, 3, bench.basic, bench.extra, bench.onoff);
+
+            tag_frame(tag, frame);
+        }
+#endif
+
+        bench.encoder.encode(frame, 1, 3, bench.basic, bench.extra, bench.onoff);
+
+        check(tag_frame(tag, frame) && (5 == tag.encoder_id()) && (3 == tag.part_index()), "decodes a tagged frame");
+
+        // Pulses just across a threshold: the soft decision moves them back,
+        // one of them with the parity, one more than the code corrects with it
+        //
+#if defined(TPPM_TAG_FEC)
+        uint8_t            errors = SOFT_DECISION_SYMBOLS;
+#else
+        uint8_t            errors = 1;
+#endif
+        TPPMEncoder::Frame noisy  = frame;
+
+        for (uint8_t e=1; e<=errors; ++e)
+        {
+            uint8_t  p      = e * 4;
+            uint16_t across = (CODE_THRESHOLD_STEP / 2) + 2;
+
+            noisy.pulse_width[p] += (noisy.pulse_width[p] < SYMBOL_WIDTH(2)) ? across : -across;
+        }
+
+        check(tag_frame(tag, noisy) && tag.is_corrected() && (3 == tag.part_index()), "corrects pulses just across a threshold");
+
+        uint8_t p = 4;
+
+        frame.pulse_width[p] += (frame.pulse_width[p] < SYMBOL_WIDTH(2)) ? CODE_THRESHOLD_STEP : -CODE_THRESHOLD_STEP;
+
+#if defined(TPPM_TAG_FEC)
+        check(tag_frame(tag, frame) && tag.is_corrected() && (3 == tag.part_index()), "corrects a pulse one level off");
+#else
+        check(!tag_frame(tag, frame), "rejects a pulse one level off");
+#endif
+
+        // Neither the corrected tags nor the plain frames move the levels
+        //
+        uint16_t levels[CODE_LEVELS];
+
+        for (uint8_t l=0; l<CODE_LEVELS; ++l)
+        {
+            levels[l] = tag.level(l);
+        }
+
+        TPPMEncoder::Frame plain;
+
+        plain_frame(plain, USEC_TO_WIDTH( 1500 ));
+
+        for (uint8_t f=0; f<100; ++f)
+        {
+            tag_frame(tag, noisy);
+            tag_frame(tag, plain);
+        }
+
+        bool kept = true;
+
+        for (uint8_t l=0; l<CODE_LEVELS; ++l)
+        {
+            kept = kept && (levels[l] == tag.level(l));
+        }
+
+        check(kept, "learns the levels from the good tags only");
+
+        // A corrected tag decoded by a locked decoder
+        //
+        TPPM::BasicChannels basic_out;
+        TPPM::FrameStamp    stamp;
+        uint32_t            history;
+        uint32_t            frames = 0;
+
+        while (bench.fresh.initializing() && (frames < 100))
+        {
+            bench.send(1, 3);
+
+            ++frames;
+        }
+
+        bench.basic[0] = USEC_TO_WIDTH( 1600 );
+
+        bench.encoder.encode(frame, 1, 3, bench.basic, bench.extra, bench.onoff);
+
+        frame.pulse_width[4] += (frame.pulse_width[4] < SYMBOL_WIDTH(2)) ? ((CODE_THRESHOLD_STEP / 2) + 2) : -((CODE_THRESHOLD_STEP / 2) + 2);
+
+        bench.replay.play(frame);
+
+        bench.fresh.frame_status(stamp, history);
+        bench.fresh.read(basic_out, NULL, NULL);
+
+#if defined(TPPM_TAG_FEC)
+        check((0x01 == (history & 0x01)) && (USEC_TO_WIDTH( 1600 ) == basic_out[0]), "decodes the channels of a corrected tag");
+#else
+        check((0x01 == (history & 0x01)) && !bench.fresh.fail_safe() && (USEC_TO_WIDTH( 1500 ) == basic_out[0]),
+              "keeps the link alive on a corrected tag, decodes none of its channels");
+#endif
+
+        // Back to the scenarios decoder
+        //
+        decoder.init(1, basic_channels, extra_channels, onoff_channels, USEC_TO_WIDTH( 1500 ), false);
+    }
+
+    printf("fingerprint\n");
+    {
+        uint32_t frames[4] = { 0 };
+
+        srand(2);
+
+        for (uint8_t t=0; t<4; ++t)
+        {
+            Bench               bench;
+            TPPMEncoder::Frame &frame = bench.frame;
+
+            for (uint32_t f=1; (f<=100) && bench.fresh.initializing(); ++f)
+            {
+                // Sticks moving every frame
+                //
+                uint16_t value = USEC_TO_WIDTH( 1100 + ((f * 37) % 800) );
+
+                if (2 == t)
+                {
+                    for (uint8_t c=0; c<BASIC_CHANNELS_COUNT; ++c)
+                    {
+                        bench.basic[c] = value;
+                    }
+
+                    bench.encoder.encode(frame, 1, 0, bench.basic, bench.extra, bench.onoff);
+                }
+                else
+                {
+                    plain_frame(frame, value);
+
+                    for (uint8_t p=0; p<=frame.channels; ++p)
+                    {
+                        // The transmitter jitter, +/-2 us
+                        //
+                        frame.pulse_width[p] += USEC_TO_WIDTH( 2 ) * ((rand() % 3) - 1);
+                    }
+
+                    if (1 == t)
+                    {
+                        // A fixed sync gap transmitter: the frame period follows the sticks
+                        //
+                        frame.sync_width = USEC_TO_WIDTH( 5000 );
+                    }
+
+                    if ((3 == t) && (5 == f))
+                    {
+                        // Another transmitter, wider pulses, interleaved
+                        //
+                        for (uint8_t p=0; p<=frame.channels; ++p)
+                        {
+                            frame.pulse_width[p] += USEC_TO_WIDTH( 50 );
+                        }
+                    }
+                }
+
+                bench.replay.play(frame);
+
+                frames[t] = f;
+            }
+        }
+
+        printf("  locked after %u, %u, %u, %u frames\n", frames[0], frames[1], frames[2], frames[3]);
+
+        check(frames[0] == GOOD_FRAMES_COUNT + 1, "locks on moving sticks and jitter");
+        check(frames[1] == GOOD_FRAMES_COUNT + 1, "locks on a fixed sync gap transmitter");
+        check((frames[2] >= GOOD_FRAMES_COUNT + 1) && (frames[2] <= GOOD_FRAMES_COUNT + 1 + PAGE_WAIT_FRAMES), "locks on a tagged stream");
+        check(frames[3] == GOOD_FRAMES_COUNT + 5, "restarts on another transmitter's frame, from its sync");
+
+        // Back to the scenarios decoder
+        //
+        decoder.init(1, basic_channels, extra_channels, onoff_channels, USEC_TO_WIDTH( 1500 ), false);
+    }
+
+    printf("flight recorder (%u frames, then a crash)\n", FLIGHT_FRAMES);
+    {
+        TPPMRecorder       recorder;
+        TPPMEncoder::Frame frame;
+        FlightLog          log = { 0, 0, 0, 0, false, false };
+
+        memset(sim_eeprom, RECORD_END, sizeof(sim_eeprom));
+
+        recorder.begin(decoder);
+
+        for (uint32_t f=0; f<FLIGHT_FRAMES + 30; ++f)
+        {
+            if (f < FLIGHT_FRAMES)
+            {
+                // A slow stick sweep, the frame's channels kept in range
+                //
+                plain_frame(frame, USEC_TO_WIDTH( 1000 + ((f * 5) % 900) ));
+            }
+            else
+            {
+                bad_frame(frame);
+            }
+
+            sim.play(frame);
+
+            // The sketch's loop: a few iterations per frame
+            //
+            recorder.update(decoder);
+
+            for (uint8_t l=0; l<8; ++l)
+            {
+                recorder.service();
+            }
+        }
+
+        while (!recorder.idle())
+        {
+            sim.silence(USEC_TO_WIDTH( 1000 ));
+
+            recorder.service();
+        }
+
+        uint32_t writes = sim_eeprom_writes;
+        uint16_t count  = TPPMRecorder::replay(flight_entry, &log);
+
+        // Hours of such sweeps before the ring's bytes reach 100000 write cycles
+        //
+        double per_frame = (double)writes / (FLIGHT_FRAMES + 30);
+        double hours     = 100000.0 * RECORDER_EEPROM_SIZE / per_frame * WIDTH_TO_USEC( PLAIN_FRAME_PERIOD ) / 3600e6;
+
+        printf("  %u entries covering %u frames in %u bytes, %.2f EEPROM writes per frame, %.0f hours endurance\n",
+               count, log.frames, RECORDER_EEPROM_SIZE, per_frame, hours);
+
+        check(count > 0, "replays the ring");
+        check(hours >= 400, "lasts 400 hours of moving sticks");
+        check(log.last_good_frame && (log.last_good_value == USEC_TO_WIDTH( 1000 + (((FLIGHT_FRAMES - 1) * 5) % 900) )),
+              "keeps the last good frame");
+        check(log.fail_safe, "ends in fail-safe");
+    }
+
+    printf("warm restart\n");
+    {
+        TPPMEncoder::Frame plain;
+        TPPM::Lock         loaded;
+        uint32_t           frames[2] = { 0 };
+
+        plain_frame(plain, USEC_TO_WIDTH( 1200 ));
+
+        memset(sim_eeprom, 0xff, sizeof(sim_eeprom));
+
+        check(!TPPMLock::load(loaded), "no lock in a virgin EEPROM");
+
+        // Lock, then persist the lock
+        //
+        {
+            Bench    cold;
+            TPPMLock lock;
+
+            lock.begin(cold.fresh);
+
+            while (cold.fresh.initializing() && (cold.replay.now() < MSEC_TO_WIDTH( 1000UL )))
+            {
+                cold.send(1, 0);
+            }
+
+            lock.update(cold.fresh);
+
+            while (!lock.idle())
+            {
+                cold.replay.silence(USEC_TO_WIDTH( 1000 ));
+
+                lock.service();
+            }
+        }
+
+        check(TPPMLock::load(loaded) && (5 == loaded.coupled_id), "persists the lock");
+
+        // Reset, then the same transmitter or another one
+        //
+        for (uint8_t t=0; t<2; ++t)
+        {
+            Bench    warm;
+            TPPMLock lock;
+
+            bool started = lock.begin(warm.fresh);
+
+            warm.fresh.read(basic_channels, NULL, NULL);
+
+            if (0 == t)
+            {
+                check(started && warm.fresh.fail_safe() && (USEC_TO_WIDTH( 1500 ) == basic_channels[0]),
+                      "outputs the persisted fail-safe at once");
+            }
+
+            for (uint32_t f=1; (f<=100) && warm.fresh.initializing(); ++f)
+            {
+                warm.encoder.encode(warm.frame, 1, 0, warm.basic, warm.extra, warm.onoff);
+
+                warm.replay.play((0 == t) ? warm.frame : plain);
+
+                frames[t] = f;
+            }
+        }
+
+        printf("  locked after %u frames, %u on another transmitter\n", frames[0], frames[1]);
+
+        check((frames[0] >= WARM_FRAMES_COUNT + 1) && (frames[0] <= WARM_FRAMES_COUNT + 1 + PAGE_WAIT_FRAMES), "locks again after WARM_FRAMES_COUNT frames");
+        check(frames[1] >  GOOD_FRAMES_COUNT + 1, "learns another transmitter from scratch");
+
+        // Resets on the persisted transmitter: it is locked on again, its
+        // record is left as it is
+        //
+        uint32_t writes = sim_eeprom_writes;
+
+        for (uint8_t r=0; r<10; ++r)
+        {
+            Bench    warm;
+            TPPMLock lock;
+
+            lock.begin(warm.fresh);
+
+            while (warm.fresh.initializing() && (warm.replay.now() < MSEC_TO_WIDTH( 1000UL )))
+            {
+                warm.send(1, 0);
+            }
+
+            lock.update(warm.fresh);
+
+            while (!lock.idle() && (warm.replay.now() < MSEC_TO_WIDTH( 2000UL )))
+            {
+                warm.replay.silence(USEC_TO_WIDTH( 1000 ));
+
+                lock.service();
+            }
+        }
+
+        check(writes == sim_eeprom_writes, "writes nothing when locking again on the same transmitter");
+
+        sim_eeprom[LOCK_EEPROM_START + LOCK_HEADER_SIZE] ^= 0x01;
+
+        check(!TPPMLock::load(loaded), "rejects a corrupted lock");
+    }
+
+    printf("frame layouts\n");
+    {
+        static const TPPM::OnOffChannels onoff     = { 0x5a, 0xc3, 0x0f, 0xf0, 0x81, 0x3c };
+        static const TPPMTag::Layout     layouts[] = { TPPMTag::LAYOUT_8CH, TPPMTag::LAYOUT_10CH, TPPMTag::LAYOUT_PLAIN };
+
+        for (uint8_t t=0; t<3; ++t)
+        {
+            Bench               bench(1, layouts[t]);
+            TPPMSum            &fresh = bench.fresh;
+            TPPM::ExtraChannels extra_out;
+            TPPM::OnOffChannels onoff_out;
+
+            memcpy(bench.onoff, onoff, sizeof(onoff));
+
+            for (uint8_t c=0; c<EXTRA_CHANNELS_COUNT; ++c)
+            {
+                bench.extra[c] = USEC_TO_WIDTH( 1000 + 40 * c );
+            }
+
+            // Lock, then a whole scan cycle
+            //
+            for (uint32_t f=0; f<GOOD_FRAMES_COUNT + PAGE_WAIT_FRAMES + ONOFF_SCAN_SLOTS + 2; ++f)
+            {
+                if (TPPMTag::LAYOUT_PLAIN == layouts[t])
+                {
+                    plain_frame(bench.frame, USEC_TO_WIDTH( 1500 ));
+
+                    bench.replay.play(bench.frame);
+                }
+                else
+                {
+                    bench.send(1, 2);
+                }
+            }
+
+            fresh.read_module(2, extra_out, onoff_out);
+
+            bool extra_match = true;
+
+            for (uint8_t c=0; c<EXTRA_CHANNELS_COUNT; ++c)
+            {
+                extra_match = extra_match && (abs((int)extra_out[c] - (int)bench.extra[c]) <= USEC_TO_WIDTH( 2 ));
+            }
+
+            if (TPPMTag::LAYOUT_8CH == layouts[t])
+            {
+                check(!fresh.initializing() && (ONOFF_NIBBLE_CHANNELS == fresh.onoff_channels_count()),
+                      "detects the 8 channels layout");
+                check(extra_match && !memcmp(onoff_out, onoff, ONOFF_NIBBLE_CHANNELS >> 3),
+                      "demuxes the 8 channels layout");
+            }
+            else
+            if (TPPMTag::LAYOUT_10CH == layouts[t])
+            {
+                check(!fresh.initializing() && (ONOFF_CHANNELS_COUNT == fresh.onoff_channels_count()),
+                      "detects the 10 channels layout");
+                check(extra_match && !memcmp(onoff_out, onoff, ONOFF_CHANNELS_BYTES),
+                      "demuxes the 10 channels layout");
+            }
+            else
+            {
+                check(!fresh.initializing()
+                      &&
+                      (0 == fresh.onoff_channels_count())
+                      &&
+                      ((PLAIN_CHANNELS - BASIC_CHANNELS_COUNT) == fresh.extra_channels_count()),
+                      "falls back to plain PPM");
+            }
+        }
+    }
+
+    printf("channel ages\n");
+    {
+        Bench             bench;
+        TPPMSum          &fresh = bench.fresh;
+        TPPM::FrameStamp  fresh_age;
+        uint32_t          frames = 0;
+
+        for (uint32_t f=0; f<2 * GOOD_FRAMES_COUNT + 16; ++f)
+        {
+            bench.send(1, 0);
+        }
+
+        fresh_age = fresh.extra_channel_age(0, 0);
+
+        // Then the frames are addressed to another decoder only, for longer
+        // than the frame stamps range in the compact builds
+        //
+        for (frames=0; frames<300; ++frames)
+        {
+            bench.send(2, 0);
+        }
+
+        TPPM::FrameStamp extra_age = fresh.extra_channel_age(0, 0);
+        TPPM::FrameStamp onoff_age = fresh.onoff_channel_age(0, 0);
+
+        printf("  ages %u then %u (extra), %u (on/off) after %u frames\n", fresh_age, extra_age, onoff_age, frames);
+
+        check(fresh_age < EXTRA_SCAN_SLOTS, "refreshes the channels");
+        check((extra_age >= min((uint32_t)MAX_SLOT_AGE, frames)) && (extra_age <= MAX_SLOT_AGE)
+              &&
+              (onoff_age >= min((uint32_t)MAX_SLOT_AGE, frames)) && (onoff_age <= MAX_SLOT_AGE),
+              "saturates the ages of the channels not refreshed");
+    }
+
+#if defined(TPPM_EXTRA_PREDICTOR)
+    printf("extra channel predictor\n");
+    {
+        Bench               bench;
+        TPPMSum            &fresh = bench.fresh;
+        TPPM::ExtraChannels extra_out;
+        uint16_t            worst = 0;
+
+        // A steady ramp of the extra channels, a tick per frame
+        //
+        for (uint32_t f=0; f<2 * GOOD_FRAMES_COUNT + 200; ++f)
+        {
+            for (uint8_t c=0; c<EXTRA_CHANNELS_COUNT; ++c)
+            {
+                ++bench.extra[c];
+            }
+
+            bench.send(1, 0);
+
+            if (f < 2 * GOOD_FRAMES_COUNT + 16)
+            {
+                continue;
+            }
+
+            fresh.read_module(0, extra_out, NULL);
+
+            for (uint8_t c=0; c<EXTRA_CHANNELS_COUNT; ++c)
+            {
+#if TPPM_EXTRA_PREDICTOR == PREDICT_INTERPOLATE
+                // One refresh period late, the paging frames stretching some
+                // of the periods
+                //
+                int16_t error = (int16_t)(bench.extra[c] - extra_out[c]) - EXTRA_SCAN_SLOTS;
+
+#if defined(TPPM_EXTENDED_ADDRESS)
+                error = (error > 0) ? max(0, error - EXTENDED_PAGE_FRAMES) : error;
+#endif
+#else
+                int16_t error = (int16_t)(bench.extra[c] - extra_out[c]);
+#endif
+                worst = max(worst, (uint16_t)abs(error));
+            }
+        }
+
+        printf("  worst error %u ticks\n", worst);
+
+        check(worst <= 2, "predicts a steady ramp of the extra channels");
+    }
+
+#endif
+    printf("priority scan\n");
+    {
+        Bench                bench;
+        TPPMSum             &fresh = bench.fresh;
+        TPPM::OnOffChannels &onoff = bench.onoff;
+        TPPM::OnOffChannels  onoff_out;
+        uint32_t             late    = 0;
+        uint8_t              decoded = 0;
+        TPPM::FrameStamp     worst   = 0;
+
+        bench.encoder.set_priority_scan(true);
+
+        for (uint32_t f=0; f<GOOD_FRAMES_COUNT + 2 * SCAN_MAX_AGE; ++f)
+        {
+            bench.send(1, 0);
+        }
+
+        // Two switches toggled in turn, one every fourth frame
+        //
+        for (uint32_t f=0; f<16 * SCAN_MAX_AGE; ++f)
+        {
+            onoff[0] ^= (0 == (f & 7)) ? 0x01 : 0x00;
+            onoff[5] ^= (4 == (f & 7)) ? 0x40 : 0x00;
+
+            bench.send(1, 0);
+
+            // Only the frames decoded into the sub-module count: not the
+            // page selects with extended addressing
+            //
+            uint8_t generation = fresh.read_module(0, NULL, onoff_out);
+
+            late += (generation != decoded) && (0 != memcmp(onoff_out, onoff, ONOFF_CHANNELS_BYTES));
+
+            decoded = generation;
+
+            for (uint8_t c=0; c<EXTRA_CHANNELS_COUNT; ++c)
+            {
+                worst = max(worst, fresh.extra_channel_age(0, c));
+            }
+
+            for (uint8_t c=0; c<ONOFF_CHANNELS_COUNT; ++c)
+            {
+                worst = max(worst, fresh.onoff_channel_age(0, c));
+            }
+        }
+
+        printf("  %u frames late, channels at most %u frames old\n", late, worst);
+
+        check(0 == late, "sends the toggled switches by the next frame");
+        check(worst < SCAN_MAX_AGE + ONOFF_SCAN_SLOTS, "bounds the untouched channels age");
+    }
+
+#if defined(TPPM_TAG_8_LEVELS)
+    printf("8 levels symbols\n");
+    {
+        static const TPPM::OnOffChannels onoff = { 0x5a, 0xc3, 0x0f, 0xf0, 0x81, 0x3c };
+
+        TPPM::FrameStamp cycle[3];
+
+        // 4 levels, 8 levels, 8 levels on a noisy link
+        //
+        for (uint8_t t=0; t<3; ++t)
+        {
+            Bench                bench;
+            TPPMSum             &fresh = bench.fresh;
+            TPPMEncoder::Frame  &frame = bench.frame;
+            TPPM::OnOffChannels  onoff_out;
+
+            memcpy(bench.onoff, onoff, sizeof(onoff));
+
+            bench.encoder.set_high_order(t > 0);
+
+            for (uint32_t f=0; f<GOOD_FRAMES_COUNT + PAGE_WAIT_FRAMES + 4 * ONOFF_SCAN_SLOTS; ++f)
+            {
+                bench.encoder.encode(frame, 1, 2, bench.basic, bench.extra, bench.onoff);
+
+                if (2 == t)
+                {
+                    // A pulse 8 us off toward the middle of its level: within
+                    // the 4 levels margin, not within the 8 levels one
+                    //
+                    uint16_t &width = frame.pulse_width[f % (frame.channels + 1)];
+
+                    if (((width - MIN_CODE_THRESHOLD) % CODE_THRESHOLD_STEP) < (CODE_THRESHOLD_STEP / 2))
+                    {
+                        width += USEC_TO_WIDTH( 8 );
+                    }
+                    else
+                    {
+                        width -= USEC_TO_WIDTH( 8 );
+                    }
+                }
+
+                bench.replay.play(frame);
+            }
+
+            fresh.read_module(2, NULL, onoff_out);
+
+            cycle[t] = fresh.scan_cycle_frames(2);
+
+            check(!memcmp(onoff_out, onoff, ONOFF_CHANNELS_BYTES), (0 == t) ? "decodes 4 levels"                :
+                                                                  (1 == t) ? "decodes 8 levels"                :
+                                                                             "falls back to 4 levels when noisy");
+        }
+
+        printf("  multiplex cycle of %u, %u and %u frames\n", cycle[0], cycle[1], cycle[2]);
+
+        check(WITHIN_PAGE_SELECT(cycle[1], ONOFF_SCAN_SLOTS >> 1), "halves the on/off refresh cycle");
+        check(WITHIN_PAGE_SELECT(cycle[2], cycle[0]) || WITHIN_PAGE_SELECT(cycle[0], cycle[2]), "refreshes on 4 levels when noisy");
+    }
+#endif
+
+#if defined(TPPM_SYNC_SYMBOLS)
+    printf("sync gap symbols\n");
+    {
+        static const TPPM::OnOffChannels onoff     = { 0x5a, 0xc3, 0x0f, 0xf0, 0x81, 0x3c };
+        static const TPPMTag::Layout     layouts[] = { TPPMTag::LAYOUT_10CH, TPPMTag::LAYOUT_8CH };
+
+        for (uint8_t t=0; t<2; ++t)
+        {
+            Bench                bench(1, layouts[t]);
+            TPPMSum             &fresh = bench.fresh;
+            TPPM::OnOffChannels  onoff_out;
+
+            memcpy(bench.onoff, onoff, sizeof(onoff));
+
+#if defined(TPPM_TAG_8_LEVELS)
+            bench.encoder.set_high_order(true);
+#endif
+
+            for (uint32_t f=0; f<GOOD_FRAMES_COUNT + PAGE_WAIT_FRAMES + 4 * ONOFF_SCAN_SLOTS; ++f)
+            {
+                // Sticks moving every frame, the sync gap follows them
+                //
+                bench.basic[0] = USEC_TO_WIDTH( 1100 + ((f * 37) % 800) );
+
+                bench.send(1, 2);
+            }
+
+            fresh.read_module(2, NULL, onoff_out);
+
+            printf("  %s: multiplex cycle of %u frames\n", (0 == t) ? "10 channels" : "8 channels", fresh.scan_cycle_frames(2));
+
+            check(!memcmp(onoff_out, onoff, fresh.onoff_channels_count() >> 3)
+                  &&
+                  WITHIN_PAGE_SELECT(fresh.scan_cycle_frames(2), ONOFF_SCAN_SLOTS >> 1),
+                  (0 == t) ? "halves the 10 channels on/off refresh" : "halves the 8 channels on/off refresh");
+        }
+
+        // A sync gap a whole step off lies within the margin of another
+        // symbol, its check fails
+        //
+        for (uint8_t t=0; t<2; ++t)
+        {
+            Bench   bench(1, layouts[t]);
+            TPPMTag tag;
+            bool    synced[2] = { false, false };
+
+            memcpy(bench.onoff, onoff, sizeof(onoff));
+
+            tag.set_decoder_id(1);
+            tag.set_layout(layouts[t]);
+
+            for (uint8_t f=0; f<2 + 2 * EXTENDED_PAGE_FRAMES; ++f)
+            {
+                uint8_t off = f & 1;
+
+                bench.encoder.encode(bench.frame, 1, 3, bench.basic, bench.extra, bench.onoff);
+
+                for (uint8_t p=0; p<=bench.frame.channels; ++p)
+                {
+                    tag.update(p + 1, bench.frame.pulse_width[p]);
+                }
+
+                tag.sync(bench.frame.sync_width + off * SYNC_SYMBOL_STEP);
+                tag.finish();
+
+                if (tag.is_valid())
+                {
+                    synced[off] = synced[off] || (0 != (tag.refreshed_slots() & (1 << SYNC_SLOT(tag.scan_index()))));
+                }
+            }
+
+            check(synced[0] && !synced[1], (0 == t) ? "rejects a 10 channels sync gap a step off" : "rejects an 8 channels sync gap a step off");
+        }
+
+#if defined(TPPM_TAG_8_LEVELS)
+        // Only the scan indexes 0, 1, 4 and 5 sent: their third bits and sync
+        // gap symbols refresh all the on/off channels, not the extra ones of
+        // the scan slots 2 and 3
+        //
+        {
+            Bench             bench;
+            TPPMSum          &fresh     = bench.fresh;
+            TPPM::FrameStamp  onoff_age = 0;
+
+            memcpy(bench.onoff, onoff, sizeof(onoff));
+
+            bench.encoder.set_high_order(true);
+
+            for (uint32_t f=0; f<2 * (GOOD_FRAMES_COUNT + PAGE_WAIT_FRAMES + 4 * ONOFF_SCAN_SLOTS); ++f)
+            {
+                bench.encoder.encode(bench.frame, 1, 2, bench.basic, bench.extra, bench.onoff);
+
+                if (0 == (bench.encoder.scan_index() & 2))
+                {
+                    bench.replay.play(bench.frame);
+                }
+            }
+
+            for (uint8_t c=0; c<fresh.onoff_channels_count(); ++c)
+            {
+                onoff_age = max(onoff_age, fresh.onoff_channel_age(2, c));
+            }
+
+            check((onoff_age < ONOFF_SCAN_SLOTS)
+                  &&
+                  (fresh.extra_channel_age(2, 0) < ONOFF_SCAN_SLOTS)
+                  &&
+                  (NEVER_REFRESHED == fresh.extra_channel_age(2, 2))
+                  &&
+                  !fresh.scan_complete(2) && (0 == fresh.scan_cycle_frames(2)),
+                  "tells the on/off only slots from the extra channels ones");
+        }
+#endif
+    }
+#endif
+
+#if defined(TPPM_EXTENDED_ADDRESS)
+    printf("extended addressing\n");
+    {
+        // Two receivers with the same tag decoder id in different pages, and
+        // one never addressed: the transmitter addresses the first two in
+        // turn, the page select of the second one is lost by the first one
+        //
+        static const uint16_t addresses[] = { 0x121, 0x341, 0x561 };
+
+        TPPM::ExtraChannels extra[2];
+        TPPM::ExtraChannels extra_out;
+
+        for (uint8_t c=0; c<EXTRA_CHANNELS_COUNT; ++c)
+        {
+            extra[0][c] = USEC_TO_WIDTH( 1200 );
+            extra[1][c] = USEC_TO_WIDTH( 1800 );
+        }
+
+        for (uint8_t t=0; t<3; ++t)
+        {
+            Bench    bench(addresses[t]);
+            TPPMSum &fresh = bench.fresh;
+
+            for (uint32_t f=0; f<8 * GOOD_FRAMES_COUNT * EXTENDED_PAGE_PERIOD; ++f)
+            {
+                uint8_t turn = (f / (2 * EXTENDED_PAGE_PERIOD)) & 1;
+
+                memcpy(bench.extra, extra[turn], sizeof(bench.extra));
+
+                if ((0 == t) && (1 == turn) && ((f % (2 * EXTENDED_PAGE_PERIOD)) < EXTENDED_PAGE_FRAMES))
+                {
+                    bench.encoder.encode(bench.frame, addresses[turn], 2, bench.basic, bench.extra, bench.onoff);
+
+                    bench.replay.silence(ENCODER_FRAME_PERIOD);
+                }
+                else
+                {
+                    bench.send(addresses[turn], 2);
+                }
+            }
+
+            fresh.read_module(2, extra_out, NULL);
+
+            if (2 == t)
+            {
+                check(NEVER_REFRESHED == fresh.extra_channel_age(2, 0), "ignores the frames addressed to other pages");
+            }
+            else
+            {
+                check(!fresh.initializing() && (extra_out[0] == extra[t][0]),
+                      (0 == t) ? "decodes the first page, despite a lost page select" : "decodes the second page");
+            }
+        }
+    }
+#endif
+
+#if (TRANSMITTERS > 1) && !defined(TPPM_EXTENDED_ADDRESS)
+    printf("multiple transmitters\n");
+    {
+        // A primary and a backup transmitter interleaving their frames to the
+        // same receiver, then an unknown one
+        //
+        TPPM::BasicChannels basic[3] = { { USEC_TO_WIDTH( 1200 ), USEC_TO_WIDTH( 1500 ), USEC_TO_WIDTH( 1500 ), USEC_TO_WIDTH( 1500 ) },
+                                         { USEC_TO_WIDTH( 1800 ), USEC_TO_WIDTH( 1500 ), USEC_TO_WIDTH( 1500 ), USEC_TO_WIDTH( 1500 ) },
+                                         { USEC_TO_WIDTH( 1900 ), USEC_TO_WIDTH( 1500 ), USEC_TO_WIDTH( 1500 ), USEC_TO_WIDTH( 1500 ) } };
+        TPPM::BasicChannels basic_out;
+
+        Bench               bench;
+        TPPMSum            &fresh       = bench.fresh;
+        TPPMSim            &replay      = bench.replay;
+        TPPMEncoder::Frame &frame       = bench.frame;
+        TPPMEncoder         encoders[3] = { TPPMEncoder(5), TPPMEncoder(6), TPPMEncoder(7) };
+
+        check(fresh.add_transmitter(5, 0) && fresh.add_transmitter(6, 1), "knows the primary and the backup");
+
+        for (uint32_t f=0; f<GOOD_FRAMES_COUNT + 2; ++f)
+        {
+            encoders[0].encode(frame, 1, 0, basic[0], bench.extra, bench.onoff);
+
+            replay.play(frame);
+        }
+
+        bool held = !fresh.initializing();
+
+        for (uint32_t f=0; f<4 * GOOD_FRAMES_COUNT; ++f)
+        {
+            for (uint8_t t=0; t<2; ++t)
+            {
+                encoders[t].encode(frame, 1, 0, basic[t], bench.extra, bench.onoff);
+
+                replay.play(frame);
+
+                fresh.read(basic_out, NULL, NULL);
+
+                held = held && (basic_out[0] == basic[0][0]);
+            }
+        }
+
+        check(held, "the primary drives the outputs");
+        check(fresh.read_transmitter(6, basic_out) && (basic_out[0] == basic[1][0]), "tracks the backup");
+
+        // The primary stops
+        //
+        uint32_t failover = 0;
+
+        for (uint32_t f=1; (f<=HOLD_FRAMES_COUNT) && (0 == failover); ++f)
+        {
+            encoders[1].encode(frame, 1, 0, basic[1], bench.extra, bench.onoff);
+
+            replay.play(frame);
+
+            fresh.read(basic_out, NULL, NULL);
+
+            if ((basic_out[0] == basic[1][0]) && !fresh.fail_safe())
+            {
+                failover = f;
+            }
+        }
+
+        printf("  failover in %u frames\n", failover);
+
+        check((0 != failover) && (failover <= TRANSMITTER_LOST_FRAMES), "fails over to the backup");
+
+        // The primary is back and takes over at once, unless the backup is
+        // selected
+        //
+        encoders[0].encode(frame, 1, 0, basic[0], bench.extra, bench.onoff);
+
+        replay.play(frame);
+
+        fresh.read(basic_out, NULL, NULL);
+
+        check(basic_out[0] == basic[0][0], "the primary takes over again");
+
+        fresh.select_transmitters(TPPM::SELECT_EXPLICIT, 6);
+
+        for (uint8_t t=2; t>0; --t)
+        {
+            encoders[t-1].encode(frame, 1, 0, basic[t-1], bench.extra, bench.onoff);
+
+            replay.play(frame);
+        }
+
+        fresh.read(basic_out, NULL, NULL);
+
+        check(basic_out[0] == basic[1][0], "the selected backup drives the outputs");
+
+        // Only an unknown transmitter
+        //
+        bool ignored = true;
+
+        for (uint32_t f=0; f<HOLD_FRAMES_COUNT; ++f)
+        {
+            encoders[2].encode(frame, 1, 0, basic[2], bench.extra, bench.onoff);
+
+            replay.play(frame);
+
+            fresh.read(basic_out, NULL, NULL);
+
+            ignored = ignored && (basic_out[0] != basic[2][0]);
+        }
+
+        check(ignored, "ignores an unknown transmitter");
+
+        // The primary and the backup taking over in turn, a new lock each
+        // time: the lock record is written once a minute at most
+        //
+        TPPMLock lock;
+        uint8_t  locks     = fresh.locks();
+        uint32_t takeovers = 0;
+        uint32_t records   = 0;
+        uint64_t start     = replay.now();
+
+        fresh.select_transmitters(TPPM::SELECT_PRIORITY);
+
+        for (uint32_t f=0; replay.now() - start < MSEC_TO_WIDTH( 150000ULL ); ++f)
+        {
+            uint8_t t = (9 == (f % 10)) ? 0 : 1;
+
+            encoders[t].encode(frame, 1, 0, basic[t], bench.extra, bench.onoff);
+
+            replay.play(frame);
+
+            uint8_t magic = sim_eeprom[LOCK_EEPROM_START];
+
+            lock.update(fresh);
+            lock.service();
+
+            records   += (0 != magic) && (0 == sim_eeprom[LOCK_EEPROM_START]);
+            takeovers += (locks != fresh.locks());
+
+            locks = fresh.locks();
+        }
+
+        printf("  %u takeovers in %u s, %u lock records written\n",
+               takeovers, (unsigned)((replay.now() - start) / MSEC_TO_WIDTH( 1000ULL )), records);
+
+        TPPM::Lock stored;
+
+        check((takeovers > 100) && (records >= 2) && (records <= 3) && TPPMLock::load(stored),
+              "writes the lock record once a minute at most");
+    }
+#endif
+
+    printf("diversity\n");
+    {
+        // Two receivers of the same transmitter, each one losing a frame in 16
+        // at random, then one of them glitching a channel
+        //
+        TPPMSum             primary;
+        TPPMSum             secondary;
+        TPPMDiversitySim    sim;
+        TPPMDiversity       diversity(primary, secondary);
+        TPPMEncoder::Frame  frames[2];
+        TPPM::BasicChannels basic_out;
+
+        primary  .init(0, NULL, NULL, NULL, USEC_TO_WIDTH( 1500 ), false);
+        secondary.init(0, NULL, NULL, NULL, USEC_TO_WIDTH( 1500 ), false, TPPM::PCINT1_INPUT);
+
+        for (uint32_t f=0; f<GOOD_FRAMES_COUNT + 2; ++f)
+        {
+            plain_frame(frames[0], USEC_TO_WIDTH( 1500 ));
+            plain_frame(frames[1], USEC_TO_WIDTH( 1500 ));
+
+            sim.play(frames[0], frames[1]);
+
+            diversity.read(basic_out, NULL, NULL);
+        }
+
+        check(!primary.initializing() && !secondary.initializing(), "locks both links");
+
+        uint32_t lost[2]  = { 0, 0 };
+        uint16_t combined = diversity.lost_frames();
+        bool     tracked  = true;
+
+        srand(3);
+
+        for (uint32_t f=0; f<4000; ++f)
+        {
+            uint16_t value = USEC_TO_WIDTH( 1200 + (f % 600) );
+
+            for (uint8_t d=0; d<2; ++d)
+            {
+                if (0 == (rand() % 16))
+                {
+                    bad_frame(frames[d]);
+
+                    ++lost[d];
+                }
+                else
+                {
+                    plain_frame(frames[d], value);
+                }
+            }
+
+            sim.play(frames[0], frames[1]);
+
+            diversity.read(basic_out, NULL, NULL);
+
+            if (TPPM::NO_LINK != diversity.links())
+            {
+                tracked = tracked && (basic_out[0] == value);
+            }
+        }
+
+        combined = diversity.lost_frames() - combined;
+
+        printf("  frames lost: %u and %u by each link, %u by both\n", lost[0], lost[1], combined);
+
+        check(tracked, "outputs the frames of either link");
+        check((10 * combined) < min(lost[0], lost[1]), "loses an order of magnitude fewer frames");
+
+        bool rejected = true;
+
+        for (uint32_t f=0; f<100; ++f)
+        {
+            uint16_t value = USEC_TO_WIDTH( 1500 + f );
+
+            plain_frame(frames[0], value);
+            plain_frame(frames[1], value);
+
+            // A channel 300 us off, a valid width anyway
+            //
+            frames[f & 1].channel_width[0] += USEC_TO_WIDTH( 300 );
+            frames[f & 1].sync_width       -= USEC_TO_WIDTH( 300 );
+
+            sim.play(frames[0], frames[1]);
+
+            diversity.read(basic_out, NULL, NULL);
+
+            rejected = rejected && (TPPM::BOTH_LINKS == diversity.links()) && (basic_out[0] == value);
+        }
+
+        check(rejected, "rejects a channel glitching on either link");
+
+        // The second decoder restarted in the middle of a pulse of the first
+        // one: the capture edge select belongs to the running decoder
+        //
+        secondary.stop();
+
+        TCCR1B ^= (1 << ICES1);
+
+        uint8_t capture_settings = TCCR1B;
+
+        secondary.init(0, NULL, NULL, NULL, USEC_TO_WIDTH( 1500 ), false, TPPM::PCINT1_INPUT);
+
+        check(TCCR1B == capture_settings, "starts the pin change input without touching the input capture");
+
+        TCCR1B ^= (1 << ICES1);
+
+        for (uint32_t f=0; f<GOOD_FRAMES_COUNT + 2; ++f)
+        {
+            plain_frame(frames[0], USEC_TO_WIDTH( 1500 ));
+            plain_frame(frames[1], USEC_TO_WIDTH( 1500 ));
+
+            sim.play(frames[0], frames[1]);
+        }
+
+        // The first decoder stopped, the second one still needs the timebase
+        //
+        TPPM::FrameStamp stamps[2];
+        uint32_t         history;
+
+        primary.stop();
+
+        secondary.frame_status(stamps[0], history);
+
+        for (uint32_t f=0; f<100; ++f)
+        {
+            plain_frame(frames[0], USEC_TO_WIDTH( 1500 ));
+            plain_frame(frames[1], USEC_TO_WIDTH( 1500 ));
+
+            sim.play(frames[0], frames[1]);
+        }
+
+        secondary.frame_status(stamps[1], history);
+
+        check((100 == (TPPM::FrameStamp)(stamps[1] - stamps[0])) && (0xffff == (history & 0xffff)), "keeps decoding the pin change input after the input capture stops");
+
+        secondary.stop();
+
+        check(0 == (TIMSK1 & (1 << TOIE1)), "stops the timebase with the last decoder");
+
+        // Back to the scenarios decoder
+        //
+        decoder.init(1, basic_channels, extra_channels, onoff_channels, USEC_TO_WIDTH( 1500 ), false);
+    }
+
+    printf("early frame rejection\n");
+    {
+        // A frame corrupted in its first channel: the decoder rejects it at
+        // the corrupted edge, the sync gap ending it starts the next frame
+        //
+        TPPM::BasicChannels basic_out;
+        TPPM::FrameStamp    stamp;
+        uint32_t            history;
+        uint32_t            frames = 0;
+
+        Bench               bench;
+        TPPMSum            &fresh  = bench.fresh;
+        TPPMSim            &replay = bench.replay;
+        TPPMEncoder::Frame  corrupted;
+        TPPMEncoder::Frame  moved;
+
+        plain_frame(corrupted, USEC_TO_WIDTH( 1500 ));
+        plain_frame(moved    , USEC_TO_WIDTH( 1600 ));
+
+        corrupted.channel_width[0]  = BAD_CHANNEL_WIDTH;
+        corrupted.sync_width       -= BAD_CHANNEL_WIDTH - USEC_TO_WIDTH( 1500 );
+
+        for (uint8_t f=0; f<3; ++f)
+        {
+            replay.play(good);
+        }
+
+        replay.play(corrupted);
+
+        while (fresh.initializing() && (frames < 100))
+        {
+            replay.play(good);
+
+            ++frames;
+        }
+
+        printf("  locked %u frames after the corrupted one\n", frames);
+
+        check(frames == GOOD_FRAMES_COUNT, "learns the transmitter from the next frame");
+
+        replay.play(corrupted);
+        replay.play(moved);
+
+        fresh.frame_status(stamp, history);
+        fresh.read(basic_out, NULL, NULL);
+
+        check((0x01 == (history & 0x03)) && (USEC_TO_WIDTH( 1600 ) == basic_out[0]), "rejects the frame, decodes the next one");
+    }
+
+    printf("missed edges\n");
+    {
+        // The interrupt of a pulse's leading edge runs after the pulse ended,
+        // as behind a long noInterrupts() section: its trailing edge is missed
+        //
+        TPPM::FrameStamp stamp;
+        uint32_t         history;
+        uint32_t         frames = 0;
+        uint8_t          missed;
+        bool             held   = true;
+
+        Bench               bench;
+        TPPMSum            &fresh  = bench.fresh;
+        TPPMSim            &replay = bench.replay;
+        TPPMEncoder::Frame &frame  = bench.frame;
+
+        plain_frame(frame, USEC_TO_WIDTH( 1500 ));
+
+        while (fresh.initializing() && (frames < 100))
+        {
+            if (3 == frames)
+            {
+                play_late(replay, frame, 2, PLAIN_PULSE_WIDTH + USEC_TO_WIDTH( 100 ));
+            }
+            else
+            {
+                replay.play(frame);
+            }
+
+            ++frames;
+        }
+
+        printf("  locked after %u frames\n", frames);
+
+        check(frames == GOOD_FRAMES_COUNT + 2, "skips the frame while learning the transmitter");
+
+        missed = fresh.missed_edges();
+
+        for (uint8_t f=0; f<100; ++f)
+        {
+            if (f & 1)
+            {
+                play_late(replay, frame, 1 + (f % (PLAIN_CHANNELS - 1)), PLAIN_PULSE_WIDTH + USEC_TO_WIDTH( 100 ));
+            }
+            else
+            {
+                replay.play(frame);
+            }
+
+            held = held && !fresh.initializing() && !fresh.fail_safe();
+        }
+
+        fresh.frame_status(stamp, history);
+
+        printf("  %u edges missed\n", (uint8_t)(fresh.missed_edges() - missed));
+
+        check(held && (50 == (uint8_t)(fresh.missed_edges() - missed)), "keeps the lock, an edge missed every other frame");
+        check(0xaaaaaaaaUL == history, "counts only the frames missing an edge as bad");
+    }
+
+    printf("interrupt run time\n");
+    {
+        // The frame is checked at its sync gap, its channels decoded, the
+        // link indicators updated and a table aged on the ends of the next
+        // three pulses
+        //
+        Bench                bench;
+        TPPMSum             &fresh  = bench.fresh;
+        TPPMSim             &replay = bench.replay;
+        TPPMEncoder::Frame  &frame  = bench.frame;
+        TPPM::ExtraChannels  extra_out;
+        uint32_t             deferred = 0;
+        bool                 staged   = true;
+        bool                 readers  = true;
+
+        for (uint8_t c=0; c<EXTRA_CHANNELS_COUNT; ++c)
+        {
+            bench.extra[c] = USEC_TO_WIDTH( 1000 + 50 * c );
+        }
+
+        for (uint32_t f=0; f<2000; ++f)
+        {
+            bench.encoder.encode(frame, 1, 2, bench.basic, bench.extra, bench.onoff);
+
+            for (uint8_t c=0; c<frame.channels; ++c)
+            {
+                replay.signal(HIGH, frame.pulse_width[c]);
+
+                if (c < 3)
+                {
+                    staged = staged && (replay.commit_stages() <= 2 - c);
+                }
+
+                replay.signal(LOW, frame.channel_width[c] - frame.pulse_width[c]);
+            }
+
+            replay.signal(HIGH, frame.pulse_width[frame.channels]);
+            replay.signal(LOW , frame.sync_width);
+
+            if (3 == replay.commit_stages())
+            {
+                ++deferred;
+
+                // The readers run the stages they depend on only
+                //
+                TPPM::LinkQuality quality;
+
+                fresh.link_quality(quality);
+
+                readers = readers && (2 == replay.commit_stages());
+#if MODULE_TABLES > 1
+                fresh.read_module(3, extra_out, NULL);
+
+                readers = readers && (2 == replay.commit_stages());
+#endif
+                fresh.read_module(2, extra_out, NULL);
+
+                readers = readers && (1 == replay.commit_stages());
+
+                TPPM::FrameStamp frame_stamp;
+                uint32_t         good_frames;
+
+                fresh.frame_status(frame_stamp, good_frames);
+                fresh.extra_channel_age(frame_stamp, 0);
+
+                readers = readers && (0 == replay.commit_stages());
+            }
+        }
+
+        fresh.read_module(2, extra_out, NULL);
+
+        for (uint8_t e=0; e<TPPMSim::EDGE_KINDS; ++e)
+        {
+            const TPPMSim::RunTime &run_time = replay.run_time((TPPMSim::Edge)e);
+
+            printf("  %-5s edges: %6llu, mean %5llu ns, worst %6llu ns (host)\n",
+                   (TPPMSim::SYNC_EDGE  == e) ? "sync"  :
+                   (TPPMSim::PULSE_EDGE == e) ? "pulse" : "gap",
+                   (unsigned long long)run_time.edges,
+                   (unsigned long long)(run_time.total / ((0 != run_time.edges) ? run_time.edges : 1)),
+                   (unsigned long long)run_time.worst);
+        }
+
+        check((deferred > 1000) && staged, "decodes on the next three pulses, a stage each");
+        check(!memcmp(extra_out, bench.extra, sizeof(extra_out)), "decodes the same channels");
+        check(readers, "runs only the stages a reader depends on");
+    }
+
+#if defined(TPPM_CLOCK_REFERENCE_US)
+    printf("clock drift\n");
+    {
+        // The clocks the same: the sync gap symbols moving the frames periods
+        // do not move the ratio
+        //
+        static const TPPM::OnOffChannels onoff = { 0x5a, 0xc3, 0x0f, 0xf0, 0x81, 0x3c };
+
+        Bench     bench;
+        TPPMSum  &fresh = bench.fresh;
+        uint16_t  worst = 0;
+
+        memcpy(bench.onoff, onoff, sizeof(onoff));
+
+        bench.encoder.set_priority_scan(true);
+
+        for (uint32_t f=0; f<GOOD_FRAMES_COUNT + (CLOCK_BLOCK_FRAMES << CLOCK_AVERAGE_SHIFT); ++f)
+        {
+            bench.basic[0] = USEC_TO_WIDTH( 1100 + ((f * 37) % 800) );
+            bench.onoff[f & 3] ^= (0 == (f % 5)) ? 0x01 : 0x00;
+
+            bench.encoder.encode(bench.frame, 1, 2, bench.basic, bench.extra, bench.onoff, USEC_TO_WIDTH( TPPM_CLOCK_REFERENCE_US ));
+
+            bench.replay.play(bench.frame);
+
+            uint16_t error = (fresh.clock_ratio() > CLOCK_RATIO_ONE) ? (fresh.clock_ratio() - CLOCK_RATIO_ONE) : (CLOCK_RATIO_ONE - fresh.clock_ratio());
+
+            worst = max(worst, error);
+        }
+
+        printf("  clocks the same: ratio at most %.4f%% off\n", (100.0 * worst) / CLOCK_RATIO_ONE);
+
+        check(((uint32_t)worst * 5000) < CLOCK_RATIO_ONE, "keeps the ratio within 0.02% of the same clocks");
+    }
+    {
+        // The receiver clock 1% fast, a ceramic resonator: all the widths are
+        // measured 1% longer
+        //
+        static const TPPM::OnOffChannels onoff = { 0x5a, 0xc3, 0x0f, 0xf0, 0x81, 0x3c };
+
+        Bench                bench;
+        TPPMSum             &fresh = bench.fresh;
+        TPPMEncoder::Frame  &frame = bench.frame;
+        TPPM::BasicChannels &basic = bench.basic;
+        TPPM::BasicChannels  basic_out;
+        TPPM::OnOffChannels  onoff_out;
+
+        memcpy(bench.onoff, onoff, sizeof(onoff));
+
+        for (uint32_t f=0; f<GOOD_FRAMES_COUNT + (CLOCK_BLOCK_FRAMES << (CLOCK_AVERAGE_SHIFT + 1)); ++f)
+        {
+            basic[0] = USEC_TO_WIDTH( 1100 + ((f * 37) % 800) );
+
+            bench.encoder.encode(frame, 1, 2, basic, bench.extra, bench.onoff, USEC_TO_WIDTH( TPPM_CLOCK_REFERENCE_US ));
+
+            for (uint8_t c=0; c<frame.channels; ++c)
+            {
+                frame.channel_width[c] = ((uint32_t)frame.channel_width[c] * 101) / 100;
+                frame.pulse_width  [c] = ((uint32_t)frame.pulse_width  [c] * 101) / 100;
+            }
+
+            frame.pulse_width[frame.channels] = ((uint32_t)frame.pulse_width[frame.channels] * 101) / 100;
+            frame.sync_width                  = ((uint32_t)frame.sync_width                  * 101) / 100;
+
+            bench.replay.play(frame);
+        }
+
+        fresh.read(basic_out, NULL, NULL);
+        fresh.read_module(2, NULL, onoff_out);
+
+        int32_t error = (int32_t)fresh.clock_ratio() - (int32_t)((CLOCK_RATIO_ONE * 100) / 101);
+
+        printf("  clock ratio %.4f, channel off by %d ticks\n",
+               (double)fresh.clock_ratio() / CLOCK_RATIO_ONE,
+               (int)basic_out[0] - (int)basic[0]);
+
+        check((error > -(int32_t)(CLOCK_RATIO_ONE / 2000)) && (error < (int32_t)(CLOCK_RATIO_ONE / 2000)), "estimates the clocks ratio within 0.05%");
+        check(IS_IN_RANGE(basic_out[0], basic[0] - USEC_TO_WIDTH( 2 ), basic[0] + USEC_TO_WIDTH( 2 )), "rescales the channels widths");
+
+#if defined(TPPM_SYNC_SYMBOLS)
+        check(!memcmp(onoff_out, onoff, fresh.onoff_channels_count() >> 3)
+              &&
+              WITHIN_PAGE_SELECT(fresh.scan_cycle_frames(2), ONOFF_SCAN_SLOTS >> 1),
+              "decodes the sync gap symbols");
+#endif
+    }
+#endif
+}
+
+// Read the next signal of a text edge stream, widths in Timer1 ticks
+//
+static bool next_text_signal(FILE *edges, uint8_t &level, uint32_t &width)
+{
+    char line[128];
+
+    while (NULL != fgets(line, sizeof(line), edges))
+    {
+        unsigned      line_level;
+        unsigned long line_width;
+
+        char *comment = strchr(line, '#');
+
+        if (NULL != comment)
+        {
+            *comment = '\0';
+        }
+
+        if (2 == sscanf(line, "%u %lu", &line_level, &line_width))
+        {
+            level = line_level ? HIGH : LOW;
+            width = USEC_TO_WIDTH( (uint64_t)line_width );
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static int convert(const char *text_path, const char *record_path)
+{
+    FILE *edges = fopen(text_path, "r");
+
+    if (NULL == edges)
+    {
+        perror(text_path);
+
+        return 2;
+    }
+
+    TPPMRecordWriter writer;
+
+    if (!writer.open(record_path, TICKS_PER_SECOND, RECORD_INDEX_INTERVAL, MIN_SYNC_WIDTH))
+    {
+        perror(record_path);
+
+        fclose(edges);
+
+        return 2;
+    }
+
+    uint8_t  level;
+    uint32_t width;
+
+    while (next_text_signal(edges, level, width))
+    {
+        writer.signal(level, width);
+    }
+
+    writer.close();
+
+    fclose(edges);
+
+    return 0;
+}
+
+static int replay(const char *path, const double &start)
+{
+    TPPMSim          sim(decoder);
+    Tracer           tracer = { false, true, false };
+    TPPMRecordReader reader;
+    FILE            *edges  = NULL;
+    uint8_t          level;
+    uint32_t         width;
+
+    if (reader.open(path))
+    {
+        if ((start > 0) && !reader.seek((uint64_t)(start * reader.ticks_per_second())))
+        {
+            fprintf(stderr, "%s: not indexed, replaying from the start\n", path);
+        }
+
+        printf("from %.6f s\n", (double)reader.time() / reader.ticks_per_second());
+    }
+    else
+    {
+        edges = fopen(path, "r");
+
+        if (NULL == edges)
+        {
+            perror(path);
+
+            return 2;
+        }
+    }
+
+    sim.set_probe(trace, &tracer);
+
+    while ((NULL != edges) ? next_text_signal(edges, level, width) : reader.next(level, width))
+    {
+        if ((NULL == edges) && (reader.ticks_per_second() != TICKS_PER_SECOND))
+        {
+            // Recorded with another Timer1 clock
+            //
+            width = ((uint64_t)width * TICKS_PER_SECOND) / reader.ticks_per_second();
+        }
+
+        sim.signal(level, width);
+    }
+
+    if (NULL != edges)
+    {
+        fclose(edges);
+    }
+
+    TPPM::LinkQuality quality;
+
+    decoder.link_quality(quality);
+
+    printf("%llu edges, %.6f s\n", (unsigned long long)sim.edges(), sim.seconds());
+    printf("link: %u fps, good frames %u/255, score %u/255\n",
+           quality.frames_per_second, quality.good_frames_ratio, quality.score);
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    decoder.init(1, basic_channels, extra_channels, onoff_channels, USEC_TO_WIDTH( 1500 ), false);
+
+    if ((argc > 3) && (0 == strcmp(argv[1], "-c")))
+    {
+        return convert(argv[2], argv[3]);
+    }
+
+    if (argc > 1)
+    {
+        return replay(argv[1], (argc > 2) ? atof(argv[2]) : 0.0);
+    }
+
+    scenarios();
+
+    printf("%s\n", failures ? "FAILED" : "PASSED");
+
+    return failures ? 1 : 0;
+}